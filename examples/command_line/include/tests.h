@@ -9,6 +9,10 @@ extern "C" {
     void ls(const char *dir);
     void simple();
     void bench(char const* logdrv);
+    void crc_bench();
+    void multi_bench(size_t argc, const char *argv[]);
+    void raid_test(const char *logdrv);
+    void raid_rebuild_test(const char *logdrv);
     void big_file_test(const char *const pathname, size_t size,
                             uint32_t seed);
     void vCreateAndVerifyExampleFiles(const char *pcMountPath);
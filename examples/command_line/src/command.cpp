@@ -15,10 +15,12 @@
 //
 #include "f_util.h"
 #include "crash.h"
+#include "dma_interrupts.h"
 #include "hw_config.h"
 #include "my_debug.h"
 #include "my_rtc.h"
 #include "sd_card.h"
+#include "RAID/sd_card_raid.h"
 #include "tests.h"
 //
 #include "diskio.h" /* Declarations of disk functions */
@@ -143,6 +145,8 @@ static char const *fs_type_string(int fs_type) {
             return "Unknown";
     }
 }
+static const char *const crc_policies[] = {"strict", "deferred", "sampled"};
+
 static void run_info(const size_t argc, const char *argv[]) {
     const char *arg = chk_dflt_log_drv(argc, argv);
     if (!arg)
@@ -157,10 +161,57 @@ static void run_info(const size_t argc, const char *argv[]) {
         printf("SD card initialization failed\n");
         return;
     }
-    // Card IDendtification register. 128 buts wide.
-    cidDmp(sd_card_p, printf);
-    // Card-Specific Data register. 128 bits wide.
-    csdDmp(sd_card_p, printf);
+    if (SD_IF_RAID == sd_card_p->type) {
+        const sd_raid_if_t *raid_p = sd_card_p->raid_if_p;
+        printf("\nStriped volume: %lu sectors, stripe %lu blocks, members:",
+               (unsigned long)sd_card_p->state.sectors, (unsigned long)raid_p->stripe_blocks);
+        for (size_t i = 0; i < raid_p->num_members; ++i)
+            printf(" %s", sd_get_drive_prefix(raid_p->members[i]));
+        printf("\n");
+        if (SD_RAID_1 == raid_p->level) {
+            static const char *const statuses[] = {"active", "failed", "rebuilding"};
+            printf("Mirror: dirty region %lu blocks\n", (unsigned long)raid_p->region_blocks);
+            for (size_t i = 0; i < raid_p->num_members; ++i) {
+                const sd_raid_member_state_t *ms_p = &raid_p->member_state[i];
+                printf("  %s %s: %lu blocks read, %lu written, %lu errors\n",
+                       sd_get_drive_prefix(raid_p->members[i]), statuses[ms_p->status],
+                       (unsigned long)ms_p->blocks_read, (unsigned long)ms_p->blocks_written,
+                       (unsigned long)ms_p->errors);
+            }
+        }
+    } else {
+        // Card IDendtification register. 128 buts wide.
+        cidDmp(sd_card_p, printf);
+        // Card-Specific Data register. 128 bits wide.
+        csdDmp(sd_card_p, printf);
+    }
+
+    if (SD_IF_SDIO == sd_card_p->type) {
+        const sd_bus_profile_t *profile_p = &sd_card_p->state.bus_profile;
+        printf("\nBus speed mode: %s, clock %.1f MHz (mode limit %.1f MHz)\n",
+               SD_BUS_SPEED_HIGH == profile_p->speed ? "High Speed" : "Default Speed",
+               profile_p->clk_hz / 1e6, profile_p->max_clk_hz / 1e6);
+        dma_irq_stats_t rx, tx;
+        dma_irq_get_stats(sd_card_p->sdio_if_p->state.SDIO_DMA_CH, &rx);
+        dma_irq_get_stats(sd_card_p->sdio_if_p->state.SDIO_DMA_CHC, &tx);
+        printf("DMA interrupts: read %lu (worst %lu us), write %lu (worst %lu us)\n",
+               (unsigned long)rx.count, (unsigned long)rx.max_us,
+               (unsigned long)tx.count, (unsigned long)tx.max_us);
+    }
+    const sd_clk_stats_t *clk_p = &sd_card_p->state.clk;
+    printf("Adaptive bus clock: %.1f MHz (ceiling %.1f MHz); "
+           "%lu CRC errors in %lu blocks; stepped down %lu, up %lu times\n",
+           clk_p->actual_hz / 1e6, clk_p->max_hz / 1e6, (unsigned long)clk_p->crc_errors,
+           (unsigned long)clk_p->blocks, (unsigned long)clk_p->steps_down,
+           (unsigned long)clk_p->steps_up);
+    const sd_crc_stats_t *crc_p = &sd_card_p->state.rx_crc;
+    printf("Receive CRC policy: %s; %lu blocks checked, %lu skipped; "
+           "errors: strict %lu, deferred %lu (%lu late), sampled %lu\n",
+           sd_card_p->rx_crc_policy < SD_CRC_POLICIES ? crc_policies[sd_card_p->rx_crc_policy] : "?",
+           (unsigned long)crc_p->checked, (unsigned long)crc_p->skipped,
+           (unsigned long)crc_p->errors[SD_CRC_STRICT],
+           (unsigned long)crc_p->errors[SD_CRC_DEFERRED], (unsigned long)crc_p->late_errors,
+           (unsigned long)crc_p->errors[SD_CRC_SAMPLED]);
     
     // SD Status
     size_t au_size_bytes;
@@ -498,6 +549,68 @@ static void run_bench(const size_t argc, const char *argv[]) {
 
     bench(arg);
 }
+static void run_crc_policy(const size_t argc, const char *argv[]) {
+    if (argc < 2) {
+        missing_argument_msg();
+        return;
+    }
+    if (argc > 3) {
+        extra_argument_msg(argv[3]);
+        return;
+    }
+    sd_card_t *sd_card_p = sd_get_by_drive_prefix(argv[0]);
+    if (!sd_card_p) {
+        printf("Unknown logical drive id: \"%s\"\n", argv[0]);
+        return;
+    }
+    size_t policy;
+    for (policy = 0; policy < SD_CRC_POLICIES; ++policy)
+        if (0 == strcmp(crc_policies[policy], argv[1])) break;
+    if (SD_CRC_POLICIES == policy) {
+        printf("Unknown policy: \"%s\"\n", argv[1]);
+        return;
+    }
+    sd_card_p->rx_crc_policy = (sd_crc_policy_t)policy;
+    if (3 == argc) sd_card_p->rx_crc_sample_interval = strtoul(argv[2], NULL, 0);
+}
+static void run_resilver(const size_t argc, const char *argv[]) {
+    if (!expect_argc(argc, argv, 1)) return;
+
+    sd_card_t *sd_card_p = sd_get_by_drive_prefix(argv[0]);
+    if (!sd_card_p) {
+        printf("Unknown logical drive id: \"%s\"\n", argv[0]);
+        return;
+    }
+    if (SD_IF_RAID != sd_card_p->type) {
+        printf("Drive \"%s\" is not a RAID volume\n", argv[0]);
+        return;
+    }
+    absolute_time_t t = get_absolute_time();
+    while (sd_raid_resilver_step(sd_card_p)) tight_loop_contents();
+    printf("Elapsed seconds %.3g\n", absolute_time_diff_us(t, get_absolute_time()) / 1e6);
+}
+static void run_raid_test(const size_t argc, const char *argv[]) {
+    if (!expect_argc(argc, argv, 1)) return;
+
+    raid_test(argv[0]);
+}
+static void run_raid_rebuild_test(const size_t argc, const char *argv[]) {
+    if (!expect_argc(argc, argv, 1)) return;
+
+    raid_rebuild_test(argv[0]);
+}
+static void run_multi_bench(const size_t argc, const char *argv[]) {
+    if (argc < 1) {
+        missing_argument_msg();
+        return;
+    }
+    multi_bench(argc, argv);
+}
+static void run_crc_bench(const size_t argc, const char *argv[]) {
+    if (!expect_argc(argc, argv, 0)) return;
+
+    crc_bench();
+}
 static void run_cdef(const size_t argc, const char *argv[]) {
     if (!expect_argc(argc, argv, 0)) return;
 
@@ -704,6 +817,35 @@ static cmd_def_t cmds[] = {
      "The SD card will need to be reformatted after this test.\n"
      "\te.g.: lliot 1"},
     {"bench", run_bench, "bench <drive#:>:\n A simple binary write/read benchmark"},
+    {"crc_policy", run_crc_policy,
+     "crc_policy <drive#:> <strict|deferred|sampled> [<N>]:\n"
+     " Set how received data blocks are CRC checked.\n"
+     " sampled checks one block in <N>. The counters are shown by info.\n"
+     "\te.g.: crc_policy 0: sampled 16"},
+    {"resilver", run_resilver,
+     "resilver <drive#:>:\n"
+     " Bring back failed members of a mirrored volume and copy what they missed.\n"
+     "\te.g.: resilver 2:"},
+    {"raid_test", run_raid_test,
+     "raid_test <drive#:>:\n"
+     " Write a pattern directly to the sectors of file raid_test.dat on a RAID volume\n"
+     " and check it. Then check it without each member of a mirror in turn.\n"
+     " Expects the volume to be already formatted and mounted.\n"
+     "\te.g.: raid_test 2:"},
+    {"raid_rebuild_test", run_raid_rebuild_test,
+     "raid_rebuild_test <drive#:>:\n"
+     " Write file raid_test.dat on a mirrored volume without its last member, resilver it,\n"
+     " then spoil the member's copy and rebuild it, checking the member's copy each time.\n"
+     " Expects the volume to be already formatted and mounted.\n"
+     "\te.g.: raid_rebuild_test 2:"},
+    {"multi_bench", run_multi_bench,
+     "multi_bench <drive#:> [<drive#:>...]:\n"
+     " Compare raw transfers on the cards one at a time and all at once.\n"
+     " Then check the data of asynchronous, vectored, unaligned and single block transfers.\n"
+     " Overwrites file multi_bench.dat on each drive.\n"
+     "\te.g.: multi_bench 0: 1:"},
+    {"crc_bench", run_crc_bench,
+     "crc_bench:\n Check and compare the SDIO CRC16 kernels (see SDIO_CRC16_KERNEL)"},
     {"big_file_test", run_big_file_test,
      "big_file_test <pathname> <size in MiB> <seed>:\n"
      " Writes random data to file <pathname>.\n"
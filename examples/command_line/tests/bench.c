@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "SDIO/SdioCard.h"
+#include "SDIO/rp2040_sdio.h"
 #include "f_util.h"
 #include "sd_card.h"
 #include "hw_config.h"
@@ -49,6 +50,16 @@ static const uint8_t READ_COUNT = 2;
 // static const uint32_t FILE_SIZE = 1000000UL * FILE_SIZE_MB;
 #define FILE_SIZE (1024 * 1024 * FILE_SIZE_MiB)
 
+// Check that buf holds what fill_buf put there
+static bool check_buf(const uint8_t* buf) {
+    for (size_t i = 0; i < BUF_SIZE - 2; i++) {
+        if (buf[i] != 'A' + (i % 26)) {
+            EMSG_PRINTF("Byte %zu is 0x%02x, expected 0x%02x\n", i, buf[i], 'A' + (i % 26));
+            return false;
+        }
+    }
+    return '\r' == buf[BUF_SIZE - 2] && '\n' == buf[BUF_SIZE - 1];
+}
 //------------------------------------------------------------------------------
 static void bench_test(FIL* file_p, uint8_t buf[BUF_SIZE]) {
     float s;
@@ -130,6 +141,7 @@ static void bench_test(FIL* file_p, uint8_t buf[BUF_SIZE]) {
         minLatency = 9999999;
         totalLatency = 0;
         skipLatency = SKIP_FIRST_LATENCY;
+        uint64_t checkTime = 0;
         t = millis();
         for (uint32_t i = 0; i < n; i++) {
             buf[BUF_SIZE - 1] = 0;
@@ -145,9 +157,12 @@ static void bench_test(FIL* file_p, uint8_t buf[BUF_SIZE]) {
             }
             m = micros() - m;
             totalLatency += m;
-            if (buf[BUF_SIZE - 1] != '\n') {
+            // Check all of the data, but leave that out of the time
+            uint64_t c = micros();
+            if (!check_buf(buf)) {
                 error("data check error");
             }
+            checkTime += micros() - c;
             if (skipLatency) {
                 skipLatency = false;
             } else {
@@ -160,7 +175,7 @@ static void bench_test(FIL* file_p, uint8_t buf[BUF_SIZE]) {
             }
         }
         s = f_size(file_p);
-        t = millis() - t;
+        t = millis() - t - checkTime / 1000;
         IMSG_PRINTF("%.1f,%lu,%lu", s / t, maxLatency, minLatency);
         IMSG_PRINTF(",%lu\n", totalLatency / n);
     }
@@ -196,6 +211,17 @@ static void bench_open_close(uint8_t* buf) {
     }
 }
 
+// fill buf with known data
+static void fill_buf(uint8_t* buf) {
+    if (BUF_SIZE > 1) {
+        for (size_t i = 0; i < (BUF_SIZE - 2); i++) {
+            buf[i] = 'A' + (i % 26);
+        }
+        buf[BUF_SIZE - 2] = '\r';
+    }
+    buf[BUF_SIZE - 1] = '\n';
+}
+
 void bench(char const* logdrv) {
     static_assert(0 == FILE_SIZE % BUF_SIZE,
                   "For accurate results, FILE_SIZE must be a multiple of BUF_SIZE.");
@@ -231,22 +257,50 @@ void bench(char const* logdrv) {
 
     cidDmp(sd_card_p, info_message_printf);
 
-    uint8_t* buf = malloc(BUF_SIZE);
+    // One extra byte so that the buffer can be offset to make it unaligned
+    uint8_t* buf = malloc(BUF_SIZE + 1);
     if (!buf) {
-        EMSG_PRINTF("malloc(%d) failed\n", BUF_SIZE);
+        EMSG_PRINTF("malloc(%d) failed\n", BUF_SIZE + 1);
         return;
     }
 
-    // fill buf with known data
-    if (BUF_SIZE > 1) {
-        for (size_t i = 0; i < (BUF_SIZE - 2); i++) {
-            buf[i] = 'A' + (i % 26);
-        }
-        buf[BUF_SIZE - 2] = '\r';
+    IMSG_PRINTF("\nAligned buffer\n");
+    fill_buf(buf);
+    bench_open_close(buf);
+
+    // FatFs passes whole sectors directly to the driver, so this exercises
+    // the driver's handling of unaligned buffers
+    IMSG_PRINTF("\nUnaligned buffer\n");
+    fill_buf(buf + 1);
+    bench_open_close(buf + 1);
+
+    // Compare with open-ended multiple block transfers (CMD12 / Stop Tran)
+    if (sd_card_p->state.cmd23_supported && !sd_card_p->no_cmd23) {
+        IMSG_PRINTF("\nAligned buffer without CMD23\n");
+        sd_card_p->no_cmd23 = true;
+        fill_buf(buf);
+        bench_open_close(buf);
+        sd_card_p->no_cmd23 = false;
     }
-    buf[BUF_SIZE - 1] = '\n';
 
-    bench_open_close(buf);
+    // Compare with multiple block writes that aren't preceded by ACMD23 SET_WR_BLK_ERASE_COUNT
+    if (sd_card_p->state.pre_erase_supported && !sd_card_p->no_pre_erase) {
+        IMSG_PRINTF("\nAligned buffer without ACMD23 pre-erase\n");
+        sd_card_p->no_pre_erase = true;
+        fill_buf(buf);
+        bench_open_close(buf);
+        sd_card_p->no_pre_erase = false;
+    }
+
+    // Compare with the SDIO checksums computed on core 1
+    if (SD_IF_SDIO == sd_card_p->type) {
+        bool enabled = sdio_crc_worker_enabled();
+        sdio_crc_worker_start();
+        IMSG_PRINTF("\nAligned buffer, SDIO checksums on core 1\n");
+        fill_buf(buf);
+        bench_open_close(buf);
+        sdio_crc_worker_enable(enabled);
+    }
 
     free(buf);
 }
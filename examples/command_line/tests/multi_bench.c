@@ -0,0 +1,260 @@
+/* Compare transfers on several cards, one card at a time and all at once.
+ *
+ * A contiguous file is allocated on each card, and its sectors are written and
+ * read directly, with asynchronous requests. The concurrent passes use
+ * sd_multi_wait, so that, for example, SDIO cards on pio0 and pio1 move data
+ * at the same time.
+ *
+ * Then the data paths of each card are checked: a pattern is written and read
+ * back with asynchronous requests, vectored (scatter-gather) requests, an
+ * unaligned buffer, and single block writes to consecutive sectors (which the
+ * SPI driver coalesces into one multiple block write).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+//
+#include "f_util.h"
+#include "ff.h"
+#include "my_debug.h"
+#include "sd_card.h"
+
+#define MULTI_BENCH_FILE "multi_bench.dat"
+
+// Size of each request in blocks
+#define MULTI_BENCH_BLOCKS 64  // 32 KiB
+
+// Amount of data per card in MiB where MiB = 1048576 bytes.
+#define MULTI_BENCH_MiB 4
+
+#define MULTI_BENCH_REQS (MULTI_BENCH_MiB * 1024 * 1024 / (MULTI_BENCH_BLOCKS * 512))
+
+// Maximum number of cards
+#define MULTI_BENCH_CARDS 4
+
+typedef struct {
+    sd_card_t *sd_card_p;
+    uint32_t first_sector;
+    uint8_t *buf;
+} bench_card_t;
+
+// Allocate a contiguous file and find its first sector
+static bool prepare(const char *logdrv, bench_card_t *card_p) {
+    card_p->sd_card_p = sd_get_by_drive_prefix(logdrv);
+    if (!card_p->sd_card_p) {
+        EMSG_PRINTF("Unknown logical drive name: %s\n", logdrv);
+        return false;
+    }
+    char path[32];
+    snprintf(path, sizeof path, "%s%s", logdrv, MULTI_BENCH_FILE);
+    FIL fil;
+    FRESULT fr = f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (FR_OK != fr) {
+        EMSG_PRINTF("f_open(%s) error: %s (%d)\n", path, FRESULT_str(fr), fr);
+        return false;
+    }
+    fr = f_expand(&fil, MULTI_BENCH_MiB * 1024 * 1024, 1);
+    if (FR_OK != fr) {
+        EMSG_PRINTF("f_expand error: %s (%d)\n", FRESULT_str(fr), fr);
+        f_close(&fil);
+        return false;
+    }
+    FATFS *fs_p = fil.obj.fs;
+    card_p->first_sector = fs_p->database + fs_p->csize * (fil.obj.sclust - 2);
+    fr = f_close(&fil);
+    if (FR_OK != fr) {
+        EMSG_PRINTF("f_close error: %s (%d)\n", FRESULT_str(fr), fr);
+        return false;
+    }
+    // One extra byte so that the buffer can be offset to make it unaligned
+    card_p->buf = malloc(MULTI_BENCH_BLOCKS * 512 + 1);
+    if (!card_p->buf) {
+        EMSG_PRINTF("malloc(%d) failed\n", MULTI_BENCH_BLOCKS * 512 + 1);
+        return false;
+    }
+    memset(card_p->buf, 0xA5, MULTI_BENCH_BLOCKS * 512);
+    return true;
+}
+
+// Transfer the whole file on each card, with the cards in [first, first + n)
+// taking part in each round of requests. Returns the time in us.
+static uint64_t run(bench_card_t cards[], size_t first, size_t n, bool write) {
+    sd_multi_xfer_t xfers[MULTI_BENCH_CARDS];
+    uint64_t t = time_us_64();
+    for (uint32_t r = 0; r < MULTI_BENCH_REQS; r++) {
+        memset(xfers, 0, sizeof xfers);
+        for (size_t i = 0; i < n; i++) {
+            bench_card_t *card_p = &cards[first + i];
+            xfers[i].sd_card_p = card_p->sd_card_p;
+            xfers[i].write = write;
+            xfers[i].buffer = card_p->buf;
+            xfers[i].sector = card_p->first_sector + r * MULTI_BENCH_BLOCKS;
+            xfers[i].count = MULTI_BENCH_BLOCKS;
+        }
+        block_dev_err_t rc = sd_multi_wait(xfers, n);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {
+            EMSG_PRINTF("%s failed: %d\n", write ? "Write" : "Read", rc);
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < n; i++) cards[first + i].sd_card_p->sync(cards[first + i].sd_card_p);
+    return time_us_64() - t;
+}
+
+static void report(const char *label, size_t n, uint64_t t) {
+    if (t)
+        IMSG_PRINTF("%s,%.1f\n", label, (double)n * MULTI_BENCH_MiB * 1024 * 1024 / t);
+}
+
+/* Data checks
+The pattern depends on the sector, so a block that lands in the wrong place
+is caught too. Each check works on its own part of the file. */
+
+// Blocks written by single block writes
+#define CHECK_SINGLE_BLOCKS 16
+
+static uint8_t pattern(uint32_t sector, size_t i, uint32_t seed) {
+    return ((sector * 512 + i) * 2654435761UL ^ seed) >> 24;
+}
+
+static void fill(uint8_t *buf, uint32_t sector, uint32_t count, uint32_t seed) {
+    for (size_t i = 0; i < count * 512; i++) buf[i] = pattern(sector + i / 512, i % 512, seed);
+}
+
+static bool check(const char *label, const uint8_t *buf, uint32_t sector, uint32_t count,
+                  uint32_t seed) {
+    for (size_t i = 0; i < count * 512; i++) {
+        if (buf[i] != pattern(sector + i / 512, i % 512, seed)) {
+            EMSG_PRINTF("%s: sector %lu, byte %zu is 0x%02x, expected 0x%02x\n", label,
+                        (unsigned long)(sector + i / 512), i % 512, buf[i],
+                        pattern(sector + i / 512, i % 512, seed));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check_rc(const char *label, block_dev_err_t rc) {
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) return true;
+    EMSG_PRINTF("%s failed: %d\n", label, rc);
+    return false;
+}
+
+static bool check_async(sd_card_t *sd_card_p, uint32_t sector, uint8_t *buf, uint32_t seed) {
+    sd_async_req_t req = {0};
+    fill(buf, sector, MULTI_BENCH_BLOCKS, seed);
+    block_dev_err_t rc = sd_card_p->write_blocks_async(sd_card_p, &req, buf, sector, MULTI_BENCH_BLOCKS);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) rc = sd_async_wait(&req);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) rc = sd_card_p->sync(sd_card_p);
+    if (!check_rc("async write", rc)) return false;
+    memset(buf, 0, MULTI_BENCH_BLOCKS * 512);
+    memset(&req, 0, sizeof req);
+    rc = sd_card_p->read_blocks_async(sd_card_p, &req, buf, sector, MULTI_BENCH_BLOCKS);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) rc = sd_async_wait(&req);
+    if (!check_rc("async read", rc)) return false;
+    return check("async", buf, sector, MULTI_BENCH_BLOCKS, seed);
+}
+
+// The segments are out of order in the buffer, and one of them is unaligned
+static bool check_iovec(sd_card_t *sd_card_p, uint32_t sector, uint8_t *buf, uint32_t seed) {
+    const sd_iovec_t wr_iov[] = {
+        {buf + 40 * 512 + 1, 3},
+        {buf, 40},
+        {buf + 43 * 512 + 1, 21},
+    };
+    uint32_t s = sector;
+    for (size_t i = 0; i < count_of(wr_iov); i++) {
+        fill(wr_iov[i].buffer, s, wr_iov[i].count, seed);
+        s += wr_iov[i].count;
+    }
+    block_dev_err_t rc = sd_card_p->write_blocks_v(sd_card_p, wr_iov, count_of(wr_iov), sector);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) rc = sd_card_p->sync(sd_card_p);
+    if (!check_rc("vectored write", rc)) return false;
+
+    const sd_iovec_t rd_iov[] = {
+        {buf + 32 * 512 + 1, 1},
+        {buf, 32},
+        {buf + 33 * 512 + 1, 31},
+    };
+    memset(buf, 0, MULTI_BENCH_BLOCKS * 512 + 1);
+    rc = sd_card_p->read_blocks_v(sd_card_p, rd_iov, count_of(rd_iov), sector);
+    if (!check_rc("vectored read", rc)) return false;
+    s = sector;
+    for (size_t i = 0; i < count_of(rd_iov); i++) {
+        if (!check("vectored", rd_iov[i].buffer, s, rd_iov[i].count, seed)) return false;
+        s += rd_iov[i].count;
+    }
+    return true;
+}
+
+static bool check_unaligned(sd_card_t *sd_card_p, uint32_t sector, uint8_t *buf, uint32_t seed) {
+    uint8_t *ubuf = buf + 1;
+    fill(ubuf, sector, MULTI_BENCH_BLOCKS, seed);
+    block_dev_err_t rc = sd_card_p->write_blocks(sd_card_p, ubuf, sector, MULTI_BENCH_BLOCKS);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) rc = sd_card_p->sync(sd_card_p);
+    if (!check_rc("unaligned write", rc)) return false;
+    memset(ubuf, 0, MULTI_BENCH_BLOCKS * 512);
+    rc = sd_card_p->read_blocks(sd_card_p, ubuf, sector, MULTI_BENCH_BLOCKS);
+    if (!check_rc("unaligned read", rc)) return false;
+    return check("unaligned", ubuf, sector, MULTI_BENCH_BLOCKS, seed);
+}
+
+static bool check_single(sd_card_t *sd_card_p, uint32_t sector, uint8_t *buf, uint32_t seed) {
+    block_dev_err_t rc = SD_BLOCK_DEVICE_ERROR_NONE;
+    for (uint32_t b = 0; SD_BLOCK_DEVICE_ERROR_NONE == rc && b < CHECK_SINGLE_BLOCKS; b++) {
+        fill(buf, sector + b, 1, seed);
+        rc = sd_card_p->write_blocks(sd_card_p, buf, sector + b, 1);
+    }
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) rc = sd_card_p->sync(sd_card_p);
+    if (!check_rc("single block write", rc)) return false;
+    memset(buf, 0, CHECK_SINGLE_BLOCKS * 512);
+    rc = sd_card_p->read_blocks(sd_card_p, buf, sector, CHECK_SINGLE_BLOCKS);
+    if (!check_rc("single block read", rc)) return false;
+    return check("single block writes", buf, sector, CHECK_SINGLE_BLOCKS, seed);
+}
+
+static bool check_card(bench_card_t *card_p) {
+    sd_card_t *sd_card_p = card_p->sd_card_p;
+    uint32_t sector = card_p->first_sector;
+    uint32_t seed = time_us_32();
+    bool ok = check_async(sd_card_p, sector, card_p->buf, seed) &&
+              check_iovec(sd_card_p, sector + MULTI_BENCH_BLOCKS, card_p->buf, seed) &&
+              check_unaligned(sd_card_p, sector + 2 * MULTI_BENCH_BLOCKS, card_p->buf, seed) &&
+              check_single(sd_card_p, sector + 3 * MULTI_BENCH_BLOCKS, card_p->buf, seed);
+    IMSG_PRINTF("%s data check %s\n", sd_get_drive_prefix(sd_card_p), ok ? "passed" : "failed");
+    return ok;
+}
+
+void multi_bench(size_t argc, const char *argv[]) {
+    if (argc > MULTI_BENCH_CARDS) {
+        EMSG_PRINTF("At most %d drives\n", MULTI_BENCH_CARDS);
+        return;
+    }
+    bench_card_t cards[MULTI_BENCH_CARDS] = {0};
+    size_t n;
+    for (n = 0; n < argc; n++)
+        if (!prepare(argv[n], &cards[n])) break;
+
+    if (n == argc) {
+        IMSG_PRINTF("MiB per card: %d, request: %d blocks\n", MULTI_BENCH_MiB, MULTI_BENCH_BLOCKS);
+        IMSG_PRINTF("pass,aggregate MB/s\n");
+        for (int write = 1; write >= 0; write--) {
+            // One card after another
+            uint64_t t = 0;
+            size_t i;
+            for (i = 0; i < n; i++) {
+                uint64_t ti = run(cards, i, 1, write);
+                if (!ti) break;
+                t += ti;
+            }
+            if (i < n) break;
+            report(write ? "write one at a time" : "read one at a time", n, t);
+            // All cards at once
+            report(write ? "write concurrently" : "read concurrently", n, run(cards, 0, n, write));
+        }
+        for (size_t i = 0; i < n; i++) check_card(&cards[i]);
+    }
+    for (size_t i = 0; i < n; i++) free(cards[i].buf);
+}
@@ -0,0 +1,271 @@
+/* Check the data on a RAID volume.
+ *
+ * A contiguous file is allocated on the volume, and its sectors are written
+ * directly with a pattern, in requests of several sizes, so that they start
+ * and end all over the stripes. They are read back in other sizes and checked.
+ * On a mirrored volume, each member in turn is then taken out, as if its card
+ * had been removed, the data is checked again as read from the others, and the
+ * member is brought back.
+ *
+ * The rebuild test takes the last member of a mirror out, writes half of the
+ * area while it is out, and lets the resilvering copy what it missed. Then it
+ * spoils the member's copy of the area, as if the card had been written
+ * elsewhere, and rebuilds it with sd_raid_rebuild. Each time, the member's
+ * copy is read directly from its card and checked.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+//
+#include "RAID/sd_card_raid.h"
+#include "f_util.h"
+#include "ff.h"
+#include "my_debug.h"
+#include "sd_card.h"
+
+#define RAID_TEST_FILE "raid_test.dat"
+
+// Size of the test area in blocks
+#define RAID_TEST_BLOCKS 1024  // 512 KiB
+
+// Size of the largest request in blocks
+#define RAID_TEST_BUF_BLOCKS 128  // 64 KiB
+
+#define WORDS_PER_BLOCK (512 / sizeof(uint32_t))
+
+// Request sizes, used in turn. With the default stripe size (64 blocks),
+// they cross stripe boundaries, and the longest reads are split between
+// the members of a mirror.
+static const uint32_t write_sizes[] = {1, 7, 64, 65, 128, 3};
+static const uint32_t read_sizes[] = {128, 5, 1, 64, 63};
+
+// Each word of the pattern depends on its sector, its place in the sector, and the seed
+static uint32_t pattern(uint32_t sector, size_t word, uint32_t seed) {
+    return (sector * WORDS_PER_BLOCK + word) * 2654435761UL ^ seed;
+}
+
+static void fill(uint8_t *buf, uint32_t sector, uint32_t count, uint32_t seed) {
+    uint32_t *words = (uint32_t *)buf;
+    for (uint32_t b = 0; b < count; b++)
+        for (size_t w = 0; w < WORDS_PER_BLOCK; w++)
+            words[b * WORDS_PER_BLOCK + w] = pattern(sector + b, w, seed);
+}
+
+static bool check(const uint8_t *buf, uint32_t sector, uint32_t count, uint32_t seed) {
+    const uint32_t *words = (const uint32_t *)buf;
+    for (uint32_t b = 0; b < count; b++) {
+        for (size_t w = 0; w < WORDS_PER_BLOCK; w++) {
+            uint32_t expected = pattern(sector + b, w, seed);
+            if (words[b * WORDS_PER_BLOCK + w] != expected) {
+                EMSG_PRINTF("Sector %lu, word %zu is 0x%08lx, expected 0x%08lx\n",
+                            (unsigned long)(sector + b), w,
+                            (unsigned long)words[b * WORDS_PER_BLOCK + w], (unsigned long)expected);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Allocate a contiguous file and find its first sector
+static bool prepare(const char *logdrv, uint32_t *first_sector_p) {
+    char path[32];
+    snprintf(path, sizeof path, "%s%s", logdrv, RAID_TEST_FILE);
+    FIL fil;
+    FRESULT fr = f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (FR_OK != fr) {
+        EMSG_PRINTF("f_open(%s) error: %s (%d)\n", path, FRESULT_str(fr), fr);
+        return false;
+    }
+    fr = f_expand(&fil, RAID_TEST_BLOCKS * 512, 1);
+    if (FR_OK != fr) {
+        EMSG_PRINTF("f_expand error: %s (%d)\n", FRESULT_str(fr), fr);
+        f_close(&fil);
+        return false;
+    }
+    FATFS *fs_p = fil.obj.fs;
+    *first_sector_p = fs_p->database + fs_p->csize * (fil.obj.sclust - 2);
+    fr = f_close(&fil);
+    if (FR_OK != fr) {
+        EMSG_PRINTF("f_close error: %s (%d)\n", FRESULT_str(fr), fr);
+        return false;
+    }
+    return true;
+}
+
+// Write blocks [first, first + blocks) with the pattern
+static bool write_area(sd_card_t *sd_card_p, uint32_t first, uint32_t blocks, uint8_t *buf,
+                       uint32_t seed) {
+    size_t k = 0;
+    for (uint32_t done = 0; done < blocks;) {
+        uint32_t count = write_sizes[k++ % count_of(write_sizes)];
+        if (count > blocks - done) count = blocks - done;
+        fill(buf, first + done, count, seed);
+        block_dev_err_t rc = sd_card_p->write_blocks(sd_card_p, buf, first + done, count);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {
+            EMSG_PRINTF("%s: write of %lu blocks at %lu failed: %d\n", sd_get_drive_prefix(sd_card_p),
+                        (unsigned long)count, (unsigned long)(first + done), rc);
+            return false;
+        }
+        done += count;
+    }
+    return SD_BLOCK_DEVICE_ERROR_NONE == sd_card_p->sync(sd_card_p);
+}
+
+// Read blocks [first, first + blocks) back and check them
+static bool read_area(sd_card_t *sd_card_p, uint32_t first, uint32_t blocks, uint8_t *buf,
+                      uint32_t seed) {
+    size_t k = 0;
+    for (uint32_t done = 0; done < blocks;) {
+        uint32_t count = read_sizes[k++ % count_of(read_sizes)];
+        if (count > blocks - done) count = blocks - done;
+        memset(buf, 0, count * 512);
+        block_dev_err_t rc = sd_card_p->read_blocks(sd_card_p, buf, first + done, count);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {
+            EMSG_PRINTF("%s: read of %lu blocks at %lu failed: %d\n", sd_get_drive_prefix(sd_card_p),
+                        (unsigned long)count, (unsigned long)(first + done), rc);
+            return false;
+        }
+        if (!check(buf, first + done, count, seed)) return false;
+        done += count;
+    }
+    return true;
+}
+
+// Take member i of a mirror out, check the data as read from the others,
+// and bring the member back
+static bool degraded_check(sd_card_t *sd_card_p, size_t i, uint32_t first, uint8_t *buf,
+                           uint32_t seed) {
+    sd_raid_if_t *raid_p = sd_card_p->raid_if_p;
+    sd_card_t *member_p = raid_p->members[i];
+    IMSG_PRINTF("Without %s\n", sd_get_drive_prefix(member_p));
+    member_p->deinit(member_p);
+    bool ok = read_area(sd_card_p, first, RAID_TEST_BLOCKS, buf, seed);
+    if (ok && SD_RAID_MEMBER_FAILED != raid_p->member_state[i].status) {
+        EMSG_PRINTF("%s was not dropped\n", sd_get_drive_prefix(member_p));
+        ok = false;
+    }
+    while (sd_raid_resilver_step(sd_card_p)) tight_loop_contents();
+    if (SD_RAID_MEMBER_ACTIVE != raid_p->member_state[i].status) {
+        EMSG_PRINTF("%s did not come back\n", sd_get_drive_prefix(member_p));
+        ok = false;
+    }
+    return ok;
+}
+
+// Check the member's own copy of the area: the first half with seed_lo,
+// the rest with seed_hi
+static bool check_member(sd_card_t *member_p, uint32_t first, uint8_t *buf, uint32_t seed_lo,
+                         uint32_t seed_hi) {
+    IMSG_PRINTF("Checking %s\n", sd_get_drive_prefix(member_p));
+    return read_area(member_p, first, RAID_TEST_BLOCKS / 2, buf, seed_lo) &&
+           read_area(member_p, first + RAID_TEST_BLOCKS / 2, RAID_TEST_BLOCKS / 2, buf, seed_hi);
+}
+
+// Resilver a mirror until member i has the area, or is active again
+static void resilver_area(sd_card_t *sd_card_p, size_t i, uint32_t first) {
+    sd_raid_if_t *raid_p = sd_card_p->raid_if_p;
+    while (sd_raid_resilver_step(sd_card_p)) {
+        if (SD_RAID_MEMBER_REBUILDING == raid_p->member_state[i].status &&
+            raid_p->resilver_sector >= first + RAID_TEST_BLOCKS)
+            break;
+    }
+}
+
+static bool rebuild_test(sd_card_t *sd_card_p, uint32_t first, uint8_t *buf, uint32_t seed) {
+    sd_raid_if_t *raid_p = sd_card_p->raid_if_p;
+    size_t i = raid_p->num_members - 1;
+    sd_card_t *member_p = raid_p->members[i];
+    uint32_t seed2 = ~seed;
+
+    if (!write_area(sd_card_p, first, RAID_TEST_BLOCKS, buf, seed)) return false;
+
+    // Writes while the member is out are marked in the dirty bitmap
+    IMSG_PRINTF("Writing without %s\n", sd_get_drive_prefix(member_p));
+    member_p->deinit(member_p);
+    if (!write_area(sd_card_p, first, RAID_TEST_BLOCKS / 2, buf, seed2)) return false;
+    if (SD_RAID_MEMBER_FAILED != raid_p->member_state[i].status) {
+        EMSG_PRINTF("%s was not dropped\n", sd_get_drive_prefix(member_p));
+        return false;
+    }
+    uint32_t region = first / raid_p->region_blocks;
+    if (!(raid_p->dirty[region / 32] & (1UL << (region % 32)))) {
+        EMSG_PRINTF("Region %lu is not dirty\n", (unsigned long)region);
+        return false;
+    }
+    IMSG_PRINTF("Resilvering\n");
+    while (sd_raid_resilver_step(sd_card_p)) tight_loop_contents();
+    if (SD_RAID_MEMBER_ACTIVE != raid_p->member_state[i].status) {
+        EMSG_PRINTF("%s did not come back\n", sd_get_drive_prefix(member_p));
+        return false;
+    }
+    for (size_t j = 0; j < raid_p->num_members; j++)
+        if (!check_member(raid_p->members[j], first, buf, seed2, seed)) return false;
+
+    // Spoil the member's copy behind the volume's back, then copy the volume to it
+    IMSG_PRINTF("Rebuilding %s\n", sd_get_drive_prefix(member_p));
+    if (!write_area(member_p, first, RAID_TEST_BLOCKS, buf, seed ^ 0x55555555)) return false;
+    sd_raid_rebuild(sd_card_p, i);
+    resilver_area(sd_card_p, i, first);
+    if (SD_RAID_MEMBER_FAILED == raid_p->member_state[i].status) {
+        EMSG_PRINTF("%s failed during the rebuild\n", sd_get_drive_prefix(member_p));
+        return false;
+    }
+    if (!check_member(member_p, first, buf, seed2, seed)) return false;
+    if (SD_RAID_MEMBER_REBUILDING == raid_p->member_state[i].status)
+        IMSG_PRINTF("The resilver command copies the rest of the volume to %s\n",
+                    sd_get_drive_prefix(member_p));
+    return true;
+}
+
+// Find the volume, allocate the test file and a buffer
+static sd_card_t *setup(const char *logdrv, uint32_t *first_p, uint8_t **buf_p) {
+    sd_card_t *sd_card_p = sd_get_by_drive_prefix(logdrv);
+    if (!sd_card_p) {
+        EMSG_PRINTF("Unknown logical drive name: %s\n", logdrv);
+        return NULL;
+    }
+    if (SD_IF_RAID != sd_card_p->type) {
+        EMSG_PRINTF("Drive %s is not a RAID volume\n", logdrv);
+        return NULL;
+    }
+    if (!prepare(logdrv, first_p)) return NULL;
+    *buf_p = malloc(RAID_TEST_BUF_BLOCKS * 512);
+    if (!*buf_p) {
+        EMSG_PRINTF("malloc(%d) failed\n", RAID_TEST_BUF_BLOCKS * 512);
+        return NULL;
+    }
+    return sd_card_p;
+}
+
+void raid_test(const char *logdrv) {
+    uint32_t first;
+    uint8_t *buf;
+    sd_card_t *sd_card_p = setup(logdrv, &first, &buf);
+    if (!sd_card_p) return;
+    uint32_t seed = time_us_32();
+    bool ok = write_area(sd_card_p, first, RAID_TEST_BLOCKS, buf, seed) &&
+              read_area(sd_card_p, first, RAID_TEST_BLOCKS, buf, seed);
+    if (ok && SD_RAID_1 == sd_card_p->raid_if_p->level) {
+        for (size_t i = 0; ok && i < sd_card_p->raid_if_p->num_members; i++)
+            ok = degraded_check(sd_card_p, i, first, buf, seed);
+    }
+    free(buf);
+    IMSG_PRINTF("%s\n", ok ? "Passed" : "Failed");
+}
+
+void raid_rebuild_test(const char *logdrv) {
+    uint32_t first;
+    uint8_t *buf;
+    sd_card_t *sd_card_p = setup(logdrv, &first, &buf);
+    if (!sd_card_p) return;
+    bool ok = false;
+    if (SD_RAID_1 != sd_card_p->raid_if_p->level)
+        EMSG_PRINTF("Drive %s is not a mirrored volume\n", logdrv);
+    else
+        ok = rebuild_test(sd_card_p, first, buf, time_us_32());
+    free(buf);
+    IMSG_PRINTF("%s\n", ok ? "Passed" : "Failed");
+}
@@ -68,6 +68,16 @@ extern const char m_Crc7Table[];
  */
 uint16_t crc16(uint8_t const *data, int const length);
 
+/**
+ * @brief Continue a CRC16 checksum over more data.
+ * 
+ * @param crc The checksum of the preceding data.
+ * @param data The data to be added.
+ * @param length The length of the data in bytes.
+ * @return The checksum of the preceding data followed by the data.
+ */
+uint16_t crc16_update(uint16_t crc, uint8_t const *data, int const length);
+
 #endif
 
 /* [] END OF FILE */
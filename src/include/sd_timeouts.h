@@ -18,6 +18,9 @@ typedef struct {
     unsigned rp2040_sdio_tx_poll;
     unsigned sd_sdio_begin;
     unsigned sd_sdio_stopTransmission;
+    unsigned sd_sdio_busy;  // 0 (e.g., in an sd_timeouts from before it was added) is the default
 } sd_timeouts_t;
 
+#define SD_SDIO_BUSY_DEFAULT_MS 500
+
 extern sd_timeouts_t sd_timeouts;
@@ -0,0 +1,597 @@
+/* sd_card_raid.c
+Copyright 2021 Carl John Kugler III
+
+Licensed under the Apache License, Version 2.0 (the License); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an AS IS BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+*/
+
+/* Striped (RAID 0) and mirrored (RAID 1) volumes over two or more member cards
+
+RAID 0: A request is cut into stripe fragments, and each fragment is one
+asynchronous transfer on its member. The fragments go to sd_multi_wait() in
+volume order, so each member gets its fragments one after another, in
+ascending order on the member, while the members work in parallel.
+
+Member stripes start at block 0 of the member. Allocation Units are powers of
+two (except the rare 12 and 24 MiB sizes), so with a power of two stripe size,
+no stripe straddles an AU boundary.
+
+RAID 1: See sd_card.h. A member that fails is marked SD_RAID_MEMBER_FAILED and
+its card is left uninitialized, so that it is initialized from scratch when it
+comes back. While any member is out, every write marks its regions in the
+dirty bitmap. A member that comes back is SD_RAID_MEMBER_REBUILDING: it gets
+the writes, and a resilver pass copies the dirty regions to it, after which
+it is active again. Bits are cleared only when no member is out.
+*/
+
+#include <string.h>
+//
+#include "pico/mutex.h"
+//
+#include "my_debug.h"
+#include "sd_card.h"
+//
+#include "sd_card_raid.h"
+
+#define TRACE_PRINTF(fmt, args...)
+// #define TRACE_PRINTF printf
+
+// Stripe fragments issued together
+#define SD_RAID_XFERS (2 * SD_RAID_MAX_MEMBERS)
+
+// Blocks copied by one resilver step
+#ifndef SD_RAID_RESILVER_BLOCKS
+#define SD_RAID_RESILVER_BLOCKS 16  // 8 KiB
+#endif
+
+#define RAID_IF (sd_card_p->raid_if_p)
+#define MEMBER(i) (RAID_IF->members[i])
+#define MSTATE(i) (RAID_IF->member_state[i])
+
+static uint32_t resilver_buf[SD_RAID_RESILVER_BLOCKS * 512 / sizeof(uint32_t)];
+auto_init_mutex(resilver_mutex);
+
+/* Dirty bitmap */
+
+static void sd_raid_set_dirty(sd_card_t *sd_card_p, uint32_t sector, uint32_t count) {
+    uint32_t last = (sector + count - 1) / RAID_IF->region_blocks;
+    for (uint32_t region = sector / RAID_IF->region_blocks; region <= last; ++region)
+        RAID_IF->dirty[region / 32] |= 1UL << (region % 32);
+}
+static void sd_raid_set_all_dirty(sd_card_t *sd_card_p) {
+    memset(RAID_IF->dirty, 0xFF, sizeof RAID_IF->dirty);
+}
+static bool sd_raid_is_dirty(sd_card_t *sd_card_p, uint32_t region) {
+    return RAID_IF->dirty[region / 32] & (1UL << (region % 32));
+}
+static void sd_raid_clear_dirty(sd_card_t *sd_card_p, uint32_t region) {
+    RAID_IF->dirty[region / 32] &= ~(1UL << (region % 32));
+}
+
+/* Members */
+
+static bool sd_raid_any(sd_card_t *sd_card_p, sd_raid_member_status_t status) {
+    for (size_t i = 0; i < RAID_IF->num_members; ++i)
+        if (status == MSTATE(i).status) return true;
+    return false;
+}
+
+// Take member i out of the volume
+static void sd_raid_fail(sd_card_t *sd_card_p, size_t i) {
+    if (SD_RAID_MEMBER_FAILED == MSTATE(i).status) return;
+    MSTATE(i).status = SD_RAID_MEMBER_FAILED;
+    MSTATE(i).errors++;
+    EMSG_PRINTF("%s: member %s failed\n", sd_get_drive_prefix(sd_card_p),
+                sd_get_drive_prefix(MEMBER(i)));
+    // Initialize from scratch when it comes back
+    sd_lock(MEMBER(i));
+    MEMBER(i)->state.m_Status |= STA_NOINIT;
+    sd_unlock(MEMBER(i));
+}
+
+// Drop the members whose cards have been removed
+static void sd_raid_check_members(sd_card_t *sd_card_p) {
+    for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+        if (SD_RAID_MEMBER_FAILED == MSTATE(i).status) continue;
+        sd_card_detect(MEMBER(i));  // Fast: just a GPIO read
+        if (MEMBER(i)->state.m_Status & (STA_NOINIT | STA_NODISK)) sd_raid_fail(sd_card_p, i);
+    }
+}
+
+// Try to bring back failed member i
+static void sd_raid_attach(sd_card_t *sd_card_p, size_t i) {
+    sd_card_t *member_p = MEMBER(i);
+    if (!sd_card_detect(member_p)) return;
+    DSTATUS ds = member_p->init(member_p);
+    if (ds & (STA_NOINIT | STA_NODISK)) return;
+    if (member_p->state.sectors < RAID_IF->member_sectors) {
+        EMSG_PRINTF("%s: card in %s is too small\n", sd_get_drive_prefix(sd_card_p),
+                    sd_get_drive_prefix(member_p));
+        return;
+    }
+    if (memcmp(MSTATE(i).CID, member_p->state.CID, sizeof(CID_t))) {
+        // Not the card that was there before
+        memcpy(MSTATE(i).CID, member_p->state.CID, sizeof(CID_t));
+        sd_raid_set_all_dirty(sd_card_p);
+    }
+    MSTATE(i).status = SD_RAID_MEMBER_REBUILDING;
+    MSTATE(i).next_sector = UINT32_MAX;
+    // Start the resilver pass over
+    RAID_IF->resilver_sector = 0;
+    DBG_PRINTF("%s: rebuilding %s\n", sd_get_drive_prefix(sd_card_p),
+               sd_get_drive_prefix(member_p));
+}
+
+// Is the card of a member still busy programming?
+static bool sd_raid_member_busy(sd_card_t *member_p) {
+    switch (member_p->type) {
+        case SD_IF_SPI:
+            return member_p->spi_if_p->state.card_busy;
+        case SD_IF_SDIO:
+            return member_p->sdio_if_p->state.card_busy;
+        default:
+            return false;
+    }
+}
+
+/* Choose an active member to read from: the one whose last read ended at
+sector, so that a read stream can continue, or else an idle one that has read
+the least. Returns num_members if none is active. */
+static size_t sd_raid_pick(sd_card_t *sd_card_p, uint32_t sector) {
+    size_t best = RAID_IF->num_members;
+    bool best_busy = true;
+    for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+        if (SD_RAID_MEMBER_ACTIVE != MSTATE(i).status) continue;
+        if (sector == MSTATE(i).next_sector) return i;
+        bool busy = sd_raid_member_busy(MEMBER(i));
+        if (best == RAID_IF->num_members || (best_busy && !busy) ||
+            (best_busy == busy && MSTATE(i).blocks_read < MSTATE(best).blocks_read)) {
+            best = i;
+            best_busy = busy;
+        }
+    }
+    return best;
+}
+
+/* Initialization */
+
+static DSTATUS sd_raid0_init(sd_card_t *sd_card_p) {
+    uint32_t sectors = UINT32_MAX;
+    DSTATUS ds = 0;
+    for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+        sd_card_t *member_p = MEMBER(i);
+        ds |= member_p->init(member_p);
+        if (ds & (STA_NOINIT | STA_NODISK)) return ds;
+        if (member_p->state.sectors < sectors) sectors = member_p->state.sectors;
+    }
+    // Whole stripes of the smallest member
+    RAID_IF->member_sectors = sectors & ~(RAID_IF->stripe_blocks - 1);
+    sd_card_p->state.sectors = RAID_IF->member_sectors * RAID_IF->num_members;
+    return ds;
+}
+
+static DSTATUS sd_raid1_init(sd_card_t *sd_card_p) {
+    uint32_t sectors = UINT32_MAX;
+    DSTATUS ds = STA_NOINIT;
+    memset(RAID_IF->member_state, 0, sizeof RAID_IF->member_state);
+    memset(RAID_IF->dirty, 0, sizeof RAID_IF->dirty);
+    RAID_IF->resilver_sector = 0;
+    for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+        sd_card_t *member_p = MEMBER(i);
+        MSTATE(i).next_sector = UINT32_MAX;
+        DSTATUS member_ds = member_p->init(member_p);
+        if (member_ds & (STA_NOINIT | STA_NODISK)) {
+            // Its CID stays zero, so it will be copied in full when it comes
+            MSTATE(i).status = SD_RAID_MEMBER_FAILED;
+            EMSG_PRINTF("%s: member %s is missing\n", sd_get_drive_prefix(sd_card_p),
+                        sd_get_drive_prefix(member_p));
+            continue;
+        }
+        ds = member_ds;
+        memcpy(MSTATE(i).CID, member_p->state.CID, sizeof(CID_t));
+        if (member_p->state.sectors < sectors) sectors = member_p->state.sectors;
+    }
+    if (ds & STA_NOINIT) return ds;
+    RAID_IF->member_sectors = sectors;
+    sd_card_p->state.sectors = sectors;
+    // The smallest power of 2 that covers the members with the bitmap
+    RAID_IF->region_blocks = RAID_IF->stripe_blocks;
+    while ((uint64_t)RAID_IF->region_blocks * SD_RAID_DIRTY_BITS < sectors)
+        RAID_IF->region_blocks <<= 1;
+    return ds;
+}
+
+static DSTATUS sd_raid_init(sd_card_t *sd_card_p) {
+    sd_lock(sd_card_p);
+    if (!(sd_card_p->state.m_Status & STA_NOINIT)) {
+        sd_unlock(sd_card_p);
+        return sd_card_p->state.m_Status;
+    }
+    DSTATUS ds;
+    if (SD_RAID_1 == RAID_IF->level)
+        ds = sd_raid1_init(sd_card_p);
+    else
+        ds = sd_raid0_init(sd_card_p);
+    if (!(ds & (STA_NOINIT | STA_NODISK))) {
+        for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+            if (SDCARD_NONE == MEMBER(i)->state.card_type) continue;
+            sd_card_p->state.card_type = MEMBER(i)->state.card_type;
+            break;
+        }
+        DBG_PRINTF("%s: RAID %d, %zu members, stripe %lu blocks, %lu sectors\n",
+                   sd_get_drive_prefix(sd_card_p), RAID_IF->level, RAID_IF->num_members,
+                   (unsigned long)RAID_IF->stripe_blocks, (unsigned long)sd_card_p->state.sectors);
+    }
+    sd_card_p->state.m_Status = ds;
+    sd_unlock(sd_card_p);
+    return ds;
+}
+
+static void sd_raid_deinit(sd_card_t *sd_card_p) {
+    for (size_t i = 0; i < RAID_IF->num_members; ++i)
+        MEMBER(i)->deinit(MEMBER(i));
+    sd_card_p->state.m_Status |= STA_NOINIT;
+    sd_card_p->state.card_type = SDCARD_NONE;
+}
+
+/* RAID 0 transfers */
+
+static block_dev_err_t sd_raid0_transfer(sd_card_t *sd_card_p, bool write, uint8_t *buffer,
+                                         uint32_t sector, uint32_t count) {
+    const uint32_t stripe_blocks = RAID_IF->stripe_blocks;
+    const size_t n = RAID_IF->num_members;
+    block_dev_err_t rc = SD_BLOCK_DEVICE_ERROR_NONE;
+    sd_multi_xfer_t xfers[SD_RAID_XFERS];
+
+    while (count && SD_BLOCK_DEVICE_ERROR_NONE == rc) {
+        size_t nx;
+        memset(xfers, 0, sizeof xfers);
+        for (nx = 0; count && nx < count_of(xfers); ++nx) {
+            uint32_t stripe = sector / stripe_blocks;
+            uint32_t offset = sector % stripe_blocks;
+            uint32_t blocks = stripe_blocks - offset;
+            if (blocks > count) blocks = count;
+
+            xfers[nx].sd_card_p = MEMBER(stripe % n);
+            xfers[nx].write = write;
+            xfers[nx].buffer = buffer;
+            xfers[nx].sector = stripe / n * stripe_blocks + offset;
+            xfers[nx].count = blocks;
+
+            buffer += blocks * sd_block_size;
+            sector += blocks;
+            count -= blocks;
+        }
+        rc = sd_multi_wait(xfers, nx);
+    }
+    return rc;
+}
+
+/* RAID 1 transfers */
+
+static block_dev_err_t sd_raid1_write(sd_card_t *sd_card_p, uint8_t *buffer, uint32_t sector,
+                                      uint32_t count) {
+    sd_multi_xfer_t xfers[SD_RAID_MAX_MEMBERS];
+    size_t members[SD_RAID_MAX_MEMBERS];
+    size_t nx = 0;
+
+    sd_raid_check_members(sd_card_p);
+    memset(xfers, 0, sizeof xfers);
+    for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+        if (SD_RAID_MEMBER_FAILED == MSTATE(i).status) continue;
+        xfers[nx].sd_card_p = MEMBER(i);
+        xfers[nx].write = true;
+        xfers[nx].buffer = buffer;
+        xfers[nx].sector = sector;
+        xfers[nx].count = count;
+        members[nx++] = i;
+    }
+    if (!nx) return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+    sd_multi_wait(xfers, nx);
+
+    block_dev_err_t rc = SD_BLOCK_DEVICE_ERROR_WRITE;
+    size_t written = 0;
+    for (size_t j = 0; j < nx; ++j) {
+        size_t i = members[j];
+        if (SD_BLOCK_DEVICE_ERROR_NONE == xfers[j].req.result) {
+            MSTATE(i).blocks_written += count;
+            if (SD_RAID_MEMBER_ACTIVE == MSTATE(i).status) ++written;
+        } else {
+            rc = xfers[j].req.result;
+            sd_raid_fail(sd_card_p, i);
+        }
+    }
+    // Remember what the members that are out have missed
+    if (sd_raid_any(sd_card_p, SD_RAID_MEMBER_FAILED)) sd_raid_set_dirty(sd_card_p, sector, count);
+    if (written) return SD_BLOCK_DEVICE_ERROR_NONE;
+    return rc;
+}
+
+static block_dev_err_t sd_raid1_read(sd_card_t *sd_card_p, uint8_t *buffer, uint32_t sector,
+                                     uint32_t count) {
+    sd_raid_check_members(sd_card_p);
+    for (;;) {
+        size_t members[SD_RAID_MAX_MEMBERS];
+        size_t n = 0;
+        for (size_t i = 0; i < RAID_IF->num_members; ++i)
+            if (SD_RAID_MEMBER_ACTIVE == MSTATE(i).status) members[n++] = i;
+        if (!n) return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+
+        if (1 == n || count < 2 * RAID_IF->stripe_blocks) {
+            size_t i = sd_raid_pick(sd_card_p, sector);
+            block_dev_err_t rc = MEMBER(i)->read_blocks(MEMBER(i), buffer, sector, count);
+            if (SD_BLOCK_DEVICE_ERROR_NONE == rc) {
+                MSTATE(i).blocks_read += count;
+                MSTATE(i).next_sector = sector + count;
+                return rc;
+            }
+            sd_raid_fail(sd_card_p, i);
+            continue;  // Try another member
+        }
+        // Long read: split it between the members
+        sd_multi_xfer_t xfers[SD_RAID_MAX_MEMBERS];
+        memset(xfers, 0, sizeof xfers);
+        uint32_t part = count / n;
+        uint32_t done = 0;
+        for (size_t j = 0; j < n; ++j) {
+            xfers[j].sd_card_p = MEMBER(members[j]);
+            xfers[j].buffer = buffer + done * sd_block_size;
+            xfers[j].sector = sector + done;
+            xfers[j].count = j + 1 < n ? part : count - done;
+            done += xfers[j].count;
+        }
+        block_dev_err_t rc = sd_multi_wait(xfers, n);
+        for (size_t j = 0; j < n; ++j) {
+            size_t i = members[j];
+            if (SD_BLOCK_DEVICE_ERROR_NONE == xfers[j].req.result) {
+                MSTATE(i).blocks_read += xfers[j].count;
+                MSTATE(i).next_sector = xfers[j].sector + xfers[j].count;
+            } else {
+                sd_raid_fail(sd_card_p, i);
+            }
+        }
+        if (SD_BLOCK_DEVICE_ERROR_NONE == rc) return rc;
+        // Read it all again from the members that are left
+    }
+}
+
+/* Block device */
+
+static block_dev_err_t sd_raid_transfer(sd_card_t *sd_card_p, bool write, uint8_t *buffer,
+                                        uint32_t sector, uint32_t count) {
+    TRACE_PRINTF("%s(%d, 0x%p, 0x%lx, 0x%lx)\n", __func__, write, buffer, sector, count);
+    if (sd_card_p->state.m_Status & (STA_NOINIT | STA_NODISK)) return SD_BLOCK_DEVICE_ERROR_NO_INIT;
+    if (!count || sector + count > sd_card_p->state.sectors) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+
+    block_dev_err_t rc;
+    sd_lock(sd_card_p);
+    if (SD_RAID_1 != RAID_IF->level)
+        rc = sd_raid0_transfer(sd_card_p, write, buffer, sector, count);
+    else if (write)
+        rc = sd_raid1_write(sd_card_p, buffer, sector, count);
+    else
+        rc = sd_raid1_read(sd_card_p, buffer, sector, count);
+    sd_unlock(sd_card_p);
+    return rc;
+}
+
+static block_dev_err_t sd_raid_write_blocks(sd_card_t *sd_card_p, const uint8_t *buffer,
+                                            uint32_t ulSectorNumber, uint32_t blockCnt) {
+    return sd_raid_transfer(sd_card_p, true, (uint8_t *)buffer, ulSectorNumber, blockCnt);
+}
+static block_dev_err_t sd_raid_read_blocks(sd_card_t *sd_card_p, uint8_t *buffer,
+                                           uint32_t ulSectorNumber, uint32_t ulSectorCount) {
+    return sd_raid_transfer(sd_card_p, false, buffer, ulSectorNumber, ulSectorCount);
+}
+
+/* Vectored transfers
+Each segment is striped by itself. */
+static block_dev_err_t sd_raid_write_blocks_v(sd_card_t *sd_card_p, const sd_iovec_t *iov,
+                                              uint32_t iovcnt, uint32_t ulSectorNumber) {
+    if (!sd_iov_blocks(iov, iovcnt)) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    block_dev_err_t rc = SD_BLOCK_DEVICE_ERROR_NONE;
+    for (uint32_t i = 0; SD_BLOCK_DEVICE_ERROR_NONE == rc && i < iovcnt; ++i) {
+        if (iov[i].count)
+            rc = sd_raid_transfer(sd_card_p, true, iov[i].buffer, ulSectorNumber, iov[i].count);
+        ulSectorNumber += iov[i].count;
+    }
+    return rc;
+}
+static block_dev_err_t sd_raid_read_blocks_v(sd_card_t *sd_card_p, const sd_iovec_t *iov,
+                                             uint32_t iovcnt, uint32_t ulSectorNumber) {
+    if (!sd_iov_blocks(iov, iovcnt)) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    block_dev_err_t rc = SD_BLOCK_DEVICE_ERROR_NONE;
+    for (uint32_t i = 0; SD_BLOCK_DEVICE_ERROR_NONE == rc && i < iovcnt; ++i) {
+        if (iov[i].count)
+            rc = sd_raid_transfer(sd_card_p, false, iov[i].buffer, ulSectorNumber, iov[i].count);
+        ulSectorNumber += iov[i].count;
+    }
+    return rc;
+}
+
+/* Asynchronous transfers
+The fragments of a request are already overlapped on the members,
+so these complete before returning. */
+static block_dev_err_t sd_raid_write_blocks_async(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                                  const uint8_t *buffer, uint32_t ulSectorNumber,
+                                                  uint32_t blockCnt) {
+    sd_async_start(sd_card_p, req_p, true, ulSectorNumber, blockCnt);
+    req_p->wr_buf = buffer;
+    block_dev_err_t rc = sd_raid_write_blocks(sd_card_p, buffer, ulSectorNumber, blockCnt);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) req_p->blocks_done = blockCnt;
+    sd_async_complete(req_p, rc);
+    return rc;
+}
+static block_dev_err_t sd_raid_read_blocks_async(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                                 uint8_t *buffer, uint32_t ulSectorNumber,
+                                                 uint32_t ulSectorCount) {
+    sd_async_start(sd_card_p, req_p, false, ulSectorNumber, ulSectorCount);
+    req_p->rd_buf = buffer;
+    block_dev_err_t rc = sd_raid_read_blocks(sd_card_p, buffer, ulSectorNumber, ulSectorCount);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) req_p->blocks_done = ulSectorCount;
+    sd_async_complete(req_p, rc);
+    return rc;
+}
+static bool sd_raid_poll_async(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    (void)sd_card_p;
+    (void)req_p;
+    return false;
+}
+
+static block_dev_err_t sd_raid_sync(sd_card_t *sd_card_p) {
+    block_dev_err_t rc = SD_BLOCK_DEVICE_ERROR_NONE;
+    sd_lock(sd_card_p);
+    for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+        if (SD_RAID_1 == RAID_IF->level && SD_RAID_MEMBER_FAILED == MSTATE(i).status) continue;
+        block_dev_err_t member_rc = MEMBER(i)->sync(MEMBER(i));
+        if (SD_BLOCK_DEVICE_ERROR_NONE == member_rc) continue;
+        if (SD_RAID_1 == RAID_IF->level)
+            sd_raid_fail(sd_card_p, i);
+        else if (SD_BLOCK_DEVICE_ERROR_NONE == rc)
+            rc = member_rc;
+    }
+    if (SD_RAID_1 == RAID_IF->level && !sd_raid_any(sd_card_p, SD_RAID_MEMBER_ACTIVE))
+        rc = SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+    sd_unlock(sd_card_p);
+    return rc;
+}
+
+static uint32_t sd_raid_sectors(sd_card_t *sd_card_p) {
+    return sd_card_p->state.sectors;
+}
+
+static bool sd_raid_test_com(sd_card_t *sd_card_p) {
+    bool ok = true;
+    for (size_t i = 0; i < RAID_IF->num_members; ++i)
+        if (!MEMBER(i)->sd_test_com(MEMBER(i))) ok = false;
+    return ok;
+}
+
+/* Resilvering */
+
+// Copy the next chunk of the resilver pass. Returns false when the pass is over.
+static bool sd_raid_resilver_chunk(sd_card_t *sd_card_p) {
+    const uint32_t region_blocks = RAID_IF->region_blocks;
+    uint32_t sector = RAID_IF->resilver_sector;
+    // Skip clean regions
+    while (sector < RAID_IF->member_sectors && !sd_raid_is_dirty(sd_card_p, sector / region_blocks))
+        sector = (sector / region_blocks + 1) * region_blocks;
+    RAID_IF->resilver_sector = sector;
+    if (sector >= RAID_IF->member_sectors) return false;
+
+    uint32_t region_end = (sector / region_blocks + 1) * region_blocks;
+    if (region_end > RAID_IF->member_sectors) region_end = RAID_IF->member_sectors;
+    uint32_t count = region_end - sector;
+    if (count > SD_RAID_RESILVER_BLOCKS) count = SD_RAID_RESILVER_BLOCKS;
+
+    size_t src = sd_raid_pick(sd_card_p, sector);
+    if (src == RAID_IF->num_members) return false;  // Nothing to copy from
+    mutex_enter_blocking(&resilver_mutex);
+    uint8_t *buffer = (uint8_t *)resilver_buf;
+    block_dev_err_t rc = MEMBER(src)->read_blocks(MEMBER(src), buffer, sector, count);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {
+        sd_raid_fail(sd_card_p, src);
+    } else {
+        MSTATE(src).next_sector = sector + count;
+        sd_multi_xfer_t xfers[SD_RAID_MAX_MEMBERS];
+        size_t members[SD_RAID_MAX_MEMBERS];
+        size_t nx = 0;
+        memset(xfers, 0, sizeof xfers);
+        for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+            if (SD_RAID_MEMBER_REBUILDING != MSTATE(i).status) continue;
+            xfers[nx].sd_card_p = MEMBER(i);
+            xfers[nx].write = true;
+            xfers[nx].buffer = buffer;
+            xfers[nx].sector = sector;
+            xfers[nx].count = count;
+            members[nx++] = i;
+        }
+        sd_multi_wait(xfers, nx);
+        for (size_t j = 0; j < nx; ++j)
+            if (SD_BLOCK_DEVICE_ERROR_NONE != xfers[j].req.result)
+                sd_raid_fail(sd_card_p, members[j]);
+        RAID_IF->resilver_sector = sector + count;
+        // The region is clean once every member has it
+        if (RAID_IF->resilver_sector == region_end && !sd_raid_any(sd_card_p, SD_RAID_MEMBER_FAILED))
+            sd_raid_clear_dirty(sd_card_p, sector / region_blocks);
+    }
+    mutex_exit(&resilver_mutex);
+    return true;
+}
+
+bool sd_raid_resilver_step(sd_card_t *sd_card_p) {
+    myASSERT(SD_IF_RAID == sd_card_p->type);
+    if (SD_RAID_1 != RAID_IF->level) return false;
+    sd_lock(sd_card_p);
+    if (sd_card_p->state.m_Status & (STA_NOINIT | STA_NODISK)) {
+        sd_unlock(sd_card_p);
+        return false;
+    }
+    sd_raid_check_members(sd_card_p);
+    for (size_t i = 0; i < RAID_IF->num_members; ++i)
+        if (SD_RAID_MEMBER_FAILED == MSTATE(i).status) sd_raid_attach(sd_card_p, i);
+
+    bool rebuilding = sd_raid_any(sd_card_p, SD_RAID_MEMBER_REBUILDING);
+    if (rebuilding && !sd_raid_resilver_chunk(sd_card_p) &&
+        sd_raid_any(sd_card_p, SD_RAID_MEMBER_ACTIVE)) {
+        // The pass is over: the members being rebuilt are in sync
+        for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+            if (SD_RAID_MEMBER_REBUILDING != MSTATE(i).status) continue;
+            MSTATE(i).status = SD_RAID_MEMBER_ACTIVE;
+            DBG_PRINTF("%s: %s is in sync\n", sd_get_drive_prefix(sd_card_p),
+                       sd_get_drive_prefix(MEMBER(i)));
+        }
+        RAID_IF->resilver_sector = 0;
+        rebuilding = false;
+    }
+    sd_unlock(sd_card_p);
+    return rebuilding;
+}
+
+void sd_raid_rebuild(sd_card_t *sd_card_p, size_t i) {
+    myASSERT(SD_IF_RAID == sd_card_p->type && SD_RAID_1 == RAID_IF->level);
+    myASSERT(i < RAID_IF->num_members);
+    sd_lock(sd_card_p);
+    sd_raid_set_all_dirty(sd_card_p);
+    if (SD_RAID_MEMBER_ACTIVE == MSTATE(i).status) {
+        MSTATE(i).status = SD_RAID_MEMBER_REBUILDING;
+        RAID_IF->resilver_sector = 0;
+    }
+    sd_unlock(sd_card_p);
+}
+
+void sd_raid_ctor(sd_card_t *sd_card_p) {
+    myASSERT(sd_card_p->raid_if_p);  // Must have an interface object
+    myASSERT(1 < RAID_IF->num_members && RAID_IF->num_members <= SD_RAID_MAX_MEMBERS);
+    for (size_t i = 0; i < RAID_IF->num_members; ++i) {
+        myASSERT(MEMBER(i));
+        myASSERT(SD_IF_RAID != MEMBER(i)->type);
+    }
+    if (!RAID_IF->stripe_blocks) RAID_IF->stripe_blocks = SD_RAID_STRIPE_BLOCKS;
+    // Must be a power of 2
+    myASSERT(!(RAID_IF->stripe_blocks & (RAID_IF->stripe_blocks - 1)));
+
+    sd_card_p->state.m_Status = STA_NOINIT;
+
+    sd_card_p->init = sd_raid_init;
+    sd_card_p->deinit = sd_raid_deinit;
+    sd_card_p->write_blocks = sd_raid_write_blocks;
+    sd_card_p->read_blocks = sd_raid_read_blocks;
+    sd_card_p->write_blocks_v = sd_raid_write_blocks_v;
+    sd_card_p->read_blocks_v = sd_raid_read_blocks_v;
+    sd_card_p->write_blocks_async = sd_raid_write_blocks_async;
+    sd_card_p->read_blocks_async = sd_raid_read_blocks_async;
+    sd_card_p->poll_async = sd_raid_poll_async;
+    sd_card_p->sync = sd_raid_sync;
+    sd_card_p->get_num_sectors = sd_raid_sectors;
+    sd_card_p->sd_test_com = sd_raid_test_com;
+}
+
+/* [] END OF FILE */
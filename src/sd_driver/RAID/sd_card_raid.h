@@ -0,0 +1,38 @@
+/* sd_card_raid.h
+Copyright 2021 Carl John Kugler III
+
+Licensed under the Apache License, Version 2.0 (the License); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an AS IS BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+*/
+
+#pragma once
+
+#include "sd_card.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sd_raid_ctor(sd_card_t *sd_card_p);  // Constructor for sd_card_t
+
+/* SD_RAID_1: Do one step of background maintenance: bring back a member that
+has failed, if it is present and initializes, or copy one chunk of a dirty
+region to the members being rebuilt. Call periodically (e.g., from the main
+loop). Returns true while there is a member to rebuild.
+Without Card Detect, a missing card is tried on every call, which can take a
+while, so call less often. */
+bool sd_raid_resilver_step(sd_card_t *sd_card_p);
+// SD_RAID_1: Copy the whole volume to member i (e.g., a card changed while powered off)
+void sd_raid_rebuild(sd_card_t *sd_card_p, size_t i);
+
+#ifdef __cplusplus
+}
+#endif
+/* [] END OF FILE */
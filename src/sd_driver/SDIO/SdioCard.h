@@ -67,7 +67,8 @@ uint32_t sd_sdio_errorData() /* const */;
 /** \return error line for last error. Tmp function for debug. */
 uint32_t sd_sdio_errorLine(sd_card_t *sd_card_p) /* const */;
 /**
- * Check for busy with CMD13.
+ * Check for busy without waiting. The card can only be busy after
+ * a write or a stop transmission, so D0 is only read then.
  *
  * \return true if busy else false.
  */
@@ -15,6 +15,8 @@
 #include "hardware/dma.h"
 #include "hardware/gpio.h"
 #include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
 #if !PICO_RISCV
 #  if PICO_RP2040
 #    include "RP2040.h"
@@ -46,6 +48,7 @@
 #define SDIO_DATA_SM STATE.SDIO_DATA_SM
 #define SDIO_DMA_CH STATE.SDIO_DMA_CH
 #define SDIO_DMA_CHB STATE.SDIO_DMA_CHB
+#define SDIO_DMA_CHC STATE.SDIO_DMA_CHC
 
 #define SDIO_CMD sd_card_p->sdio_if_p->CMD_gpio
 #define SDIO_CLK sd_card_p->sdio_if_p->CLK_gpio
@@ -54,10 +57,30 @@
 #define SDIO_D2 sd_card_p->sdio_if_p->D2_gpio
 #define SDIO_D3 sd_card_p->sdio_if_p->D3_gpio
 
+static_assert(SDIO_RING_BLOCKS >= 2 && (SDIO_RING_BLOCKS & (SDIO_RING_BLOCKS - 1)) == 0,
+              "SDIO_RING_BLOCKS must be a power of 2, at least 2");
+static_assert(SDIO_CRC_QUEUE_LEN >= SDIO_RING_BLOCKS && (SDIO_CRC_QUEUE_LEN & (SDIO_CRC_QUEUE_LEN - 1)) == 0,
+              "SDIO_CRC_QUEUE_LEN must be a power of 2, at least SDIO_RING_BLOCKS");
+static_assert(SDIO_RX_DEFERRED_BLOCKS >= 1 && SDIO_RX_DEFERRED_BLOCKS <= SDIO_CRC_QUEUE_LEN,
+              "SDIO_RX_DEFERRED_BLOCKS must be from 1 to SDIO_CRC_QUEUE_LEN");
 
 // Force everything to idle state
 static sdio_status_t rp2040_sdio_stop(sd_card_t *sd_card_p);
 
+// The data reception and transmission programs don't both fit in the PIO
+// instruction memory alongside the command program, so they take turns
+// at the same offset.
+static void sdio_load_data_program(sd_card_t *sd_card_p, const pio_program_t *program)
+{
+    pio_sm_set_enabled(SDIO_PIO, SDIO_DATA_SM, false);
+    if (STATE.pio_data_program == program)
+        return;
+    if (STATE.pio_data_program)
+        pio_remove_program(SDIO_PIO, STATE.pio_data_program, STATE.pio_data_rx_offset);
+    pio_add_program_at_offset(SDIO_PIO, program, STATE.pio_data_rx_offset);
+    STATE.pio_data_program = program;
+}
+
 /*******************************************************
  * Checksum algorithms
  *******************************************************/
@@ -90,40 +113,253 @@ static const uint8_t crc7_table[256] = {
 // When the SDIO bus operates in 4-bit mode, the CRC16 algorithm
 // is applied to each line separately and generates total of
 // 4 x 16 = 64 bits of checksum.
+// Each step takes one 32-bit big-endian word, which contains 8 bits per line.
+static inline uint64_t sdio_crc16_4bit_step(uint64_t crc, uint32_t data_in)
+{
+    // Shift out 8 bits for each line
+    uint32_t data_out = crc >> 32;
+    crc <<= 32;
+
+    // XOR outgoing data to itself with 4 bit delay
+    data_out ^= (data_out >> 16);
+
+    // XOR incoming data to outgoing data with 4 bit delay
+    data_out ^= (data_in >> 16);
+
+    // XOR outgoing and incoming data to accumulator at each tap
+    uint64_t xorred = data_out ^ data_in;
+    crc ^= xorred;
+    crc ^= xorred << (5 * 4);
+    crc ^= xorred << (12 * 4);
+    return crc;
+}
+
+// The step above is linear: with t = (crc >> 32) ^ data_in and x = t ^ (t >> 16),
+// the new crc is (crc << 32) ^ x ^ (x << 20) ^ (x << 48).
+// The kernels below compute the same checksum in different ways.
+// SDIO_CRC16_KERNEL selects the one used by the driver; the crc_bench command
+// of the command_line example compares them on the target.
+
+// One word per step, with 64-bit shifts (the original kernel)
 __attribute__((optimize("Ofast")))
-uint64_t sdio_crc16_4bit_checksum(uint32_t *data, uint32_t num_words)
+uint64_t sdio_crc16_4bit_checksum_shift64(uint32_t *data, uint32_t num_words)
 {
     uint64_t crc = 0;
     uint32_t *end = data + num_words;
-    while (data < end)
+    while (end - data >= 4)
     {
         for (int unroll = 0; unroll < 4; unroll++)
         {
-            // Each 32-bit word contains 8 bits per line.
             // Reverse the bytes because SDIO protocol is big-endian.
-            uint32_t data_in = __builtin_bswap32(*data++);
-
-            // Shift out 8 bits for each line
-            uint32_t data_out = crc >> 32;
-            crc <<= 32;
+            crc = sdio_crc16_4bit_step(crc, __builtin_bswap32(*data++));
+        }
+    }
+    // Short blocks, like the 8 byte SCR
+    while (data < end)
+        crc = sdio_crc16_4bit_step(crc, __builtin_bswap32(*data++));
 
-            // XOR outgoing data to itself with 4 bit delay
-            data_out ^= (data_out >> 16);
+    return crc;
+}
 
-            // XOR incoming data to outgoing data with 4 bit delay
-            data_out ^= (data_in >> 16);
+// Table driven: the contribution of each byte of t is looked up.
+// The tables take 8 KB of RAM, and are built on first use.
+static uint64_t crc16_4bit_tables[4][256];
+static volatile bool crc16_4bit_tables_ready;
 
-            // XOR outgoing and incoming data to accumulator at each tap
-            uint64_t xorred = data_out ^ data_in;
-            crc ^= xorred;
-            crc ^= xorred << (5 * 4);
-            crc ^= xorred << (12 * 4);
+static void sdio_crc16_4bit_tables_init(void)
+{
+    for (uint32_t b = 0; b < 4; b++)
+    {
+        for (uint32_t v = 0; v < 256; v++)
+        {
+            uint32_t t = v << (8 * b);
+            uint64_t x = t ^ (t >> 16);
+            crc16_4bit_tables[b][v] = x ^ (x << 20) ^ (x << 48);
         }
     }
+    __dmb();
+    crc16_4bit_tables_ready = true;
+}
 
+__attribute__((optimize("Ofast")))
+uint64_t sdio_crc16_4bit_checksum_table(uint32_t *data, uint32_t num_words)
+{
+    if (!crc16_4bit_tables_ready)
+        sdio_crc16_4bit_tables_init();
+    uint64_t crc = 0;
+    for (uint32_t i = 0; i < num_words; i++)
+    {
+        uint32_t t = (uint32_t)(crc >> 32) ^ __builtin_bswap32(data[i]);
+        crc = (crc << 32) ^
+              crc16_4bit_tables[0][t & 0xFF] ^ crc16_4bit_tables[1][(t >> 8) & 0xFF] ^
+              crc16_4bit_tables[2][(t >> 16) & 0xFF] ^ crc16_4bit_tables[3][t >> 24];
+    }
     return crc;
 }
 
+// The crc is kept in two 32-bit halves, so there are no 64-bit shifts.
+// On Cortex-M33 (and M0+), each XOR with a shifted value is a single EOR with a shifted
+// operand, and the byte swap is REV. On Hazard3, the byte swap is the Zbb rev8.
+__attribute__((optimize("Ofast")))
+uint64_t sdio_crc16_4bit_checksum_split32(uint32_t *data, uint32_t num_words)
+{
+    uint32_t hi = 0, lo = 0;
+    for (uint32_t i = 0; i < num_words; i++)
+    {
+        uint32_t t = hi ^ __builtin_bswap32(data[i]);
+        uint32_t x = t ^ (t >> 16);
+        hi = lo ^ (x >> 12) ^ (x << 16);
+        lo = x ^ (x << 20);
+    }
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Same, two words per step. The second word is folded into the low half
+// while the first one is being processed, which shortens the dependency chain.
+__attribute__((optimize("Ofast")))
+uint64_t sdio_crc16_4bit_checksum_pair(uint32_t *data, uint32_t num_words)
+{
+    uint32_t hi = 0, lo = 0;
+    uint32_t *end = data + (num_words & ~1u);
+    while (data < end)
+    {
+        uint32_t t1 = hi ^ __builtin_bswap32(data[0]);
+        uint32_t lo_w2 = lo ^ __builtin_bswap32(data[1]);
+        data += 2;
+        uint32_t x1 = t1 ^ (t1 >> 16);
+        uint32_t t2 = lo_w2 ^ (x1 >> 12) ^ (x1 << 16);
+        uint32_t x2 = t2 ^ (t2 >> 16);
+        hi = x1 ^ (x1 << 20) ^ (x2 >> 12) ^ (x2 << 16);
+        lo = x2 ^ (x2 << 20);
+    }
+    if (num_words & 1)
+    {
+        uint32_t t = hi ^ __builtin_bswap32(*data);
+        uint32_t x = t ^ (t >> 16);
+        hi = lo ^ (x >> 12) ^ (x << 16);
+        lo = x ^ (x << 20);
+    }
+    return ((uint64_t)hi << 32) | lo;
+}
+
+uint64_t sdio_crc16_4bit_checksum(uint32_t *data, uint32_t num_words)
+{
+#if SDIO_CRC16_KERNEL == SDIO_CRC16_TABLE
+    return sdio_crc16_4bit_checksum_table(data, num_words);
+#elif SDIO_CRC16_KERNEL == SDIO_CRC16_SPLIT32
+    return sdio_crc16_4bit_checksum_split32(data, num_words);
+#elif SDIO_CRC16_KERNEL == SDIO_CRC16_PAIR
+    return sdio_crc16_4bit_checksum_pair(data, num_words);
+#else
+    return sdio_crc16_4bit_checksum_shift64(data, num_words);
+#endif
+}
+
+// Same, for data that is not word aligned
+__attribute__((optimize("Ofast")))
+static uint64_t sdio_crc16_4bit_checksum_bytes(const uint8_t *data, uint32_t num_words)
+{
+    uint64_t crc = 0;
+    const uint8_t *end = data + num_words * sizeof(uint32_t);
+    while (data < end)
+    {
+        uint32_t data_in = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+                           ((uint32_t)data[2] << 8) | data[3];
+        data += 4;
+        crc = sdio_crc16_4bit_step(crc, data_in);
+    }
+
+    return crc;
+}
+
+/*******************************************************
+ * Checksum worker on core 1
+ *******************************************************/
+
+// Single producer (core 0), single consumer (core 1) queue of checksum jobs.
+// On core 0, both the IRQ handler and the thread submit jobs,
+// so submission is done with interrupts disabled.
+static struct {
+    sdio_crc_job_t *volatile jobs[SDIO_CRC_QUEUE_LEN];
+    volatile uint32_t head; // Advanced by core 0
+    volatile uint32_t tail; // Advanced by core 1
+    volatile bool running;
+    volatile bool enabled;
+} crc_worker;
+
+static uint64_t sdio_block_checksum(const uint8_t *data, uint32_t num_words)
+{
+    if (((uint32_t)data & 3) != 0)
+        return sdio_crc16_4bit_checksum_bytes(data, num_words);
+    else
+        return sdio_crc16_4bit_checksum((uint32_t *)data, num_words);
+}
+
+static void sdio_crc_job_compute(sdio_crc_job_t *job)
+{
+    job->crc = sdio_block_checksum(job->data, job->num_words);
+    __dmb();
+    job->done = true;
+}
+
+static void __not_in_flash_func(sdio_crc_worker_main)(void)
+{
+    for (;;)
+    {
+        uint32_t tail = crc_worker.tail;
+        while (tail == crc_worker.head)
+            __wfe();
+        __dmb();
+        sdio_crc_job_compute(crc_worker.jobs[tail % SDIO_CRC_QUEUE_LEN]);
+        crc_worker.tail = tail + 1;
+        // Wake up core 0, if it is waiting for the checksum
+        __sev();
+    }
+}
+
+void sdio_crc_worker_start(void)
+{
+    myASSERT(get_core_num() == 0);
+    if (!crc_worker.running)
+    {
+        multicore_launch_core1(sdio_crc_worker_main);
+        crc_worker.running = true;
+    }
+    crc_worker.enabled = true;
+}
+
+void sdio_crc_worker_enable(bool enable)
+{
+    crc_worker.enabled = enable && crc_worker.running;
+}
+
+bool sdio_crc_worker_enabled(void)
+{
+    return crc_worker.enabled;
+}
+
+// Queue a checksum for the worker.
+// If the queue is full, compute it right away.
+static void sdio_crc_submit(sdio_crc_job_t *job, const uint8_t *data, uint32_t num_words)
+{
+    job->data = data;
+    job->num_words = num_words;
+    job->done = false;
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t head = crc_worker.head;
+    if (head - crc_worker.tail >= SDIO_CRC_QUEUE_LEN)
+    {
+        restore_interrupts(save);
+        sdio_crc_job_compute(job);
+        return;
+    }
+    crc_worker.jobs[head % SDIO_CRC_QUEUE_LEN] = job;
+    __dmb();
+    crc_worker.head = head + 1;
+    restore_interrupts(save);
+    __sev();
+}
+
 /*******************************************************
  * Basic SDIO command execution
  *******************************************************/
@@ -342,57 +578,253 @@ sdio_status_t rp2040_sdio_command_R3(sd_card_t *sd_card_p, uint8_t command, uint
     return SDIO_OK;
 }
 
+/*******************************************************
+ * DMA descriptor ring
+ *******************************************************/
+
+// Block transfers are driven by a circular list of DMA control blocks.
+// The second DMA channel loads each control block into the alias 0 registers
+// of the first one, which chains back to the second when it is done.
+// Each ring slot ends with a "kill" control block that clears the trigger
+// word of the slot, so that a slot that has not been refilled in time
+// stops the chain instead of being replayed.
+// The last control block copies the start address of the ring back into
+// the read address of the second channel.
+//
+// In a read stream, the kill control block replaces the first control block
+// of the slot with a "brake" instead, which disables the command and data
+// state machines in the same cycle. This stops the bus clock, which the
+// SD specification allows the host to do for flow control, and so pauses
+// the card until the state machines are enabled again.
+
+static void sdio_iov_seek(sdio_iov_iter_t *it)
+{
+    while (!it->blocks_left && it->segs_left)
+    {
+        it->buf = it->next_seg->buffer;
+        it->blocks_left = it->next_seg->count;
+        it->next_seg++;
+        it->segs_left--;
+    }
+}
+
+static void sdio_iov_init(sdio_iov_iter_t *it, const sd_iovec_t *iov, uint32_t iovcnt)
+{
+    it->buf = 0;
+    it->blocks_left = 0;
+    it->next_seg = iov;
+    it->segs_left = iovcnt;
+    sdio_iov_seek(it);
+}
+
+// Returns the next block and moves past it
+static uint8_t *sdio_iov_next(sdio_iov_iter_t *it, size_t block_size)
+{
+    uint8_t *buf = it->buf;
+    it->buf += block_size;
+    it->blocks_left--;
+    sdio_iov_seek(it);
+    return buf;
+}
+
+static void sdio_set_cb(sdio_dma_cb_t *cb, const volatile void *read_addr, volatile void *write_addr,
+                        uint32_t transfer_count, uint32_t ctrl)
+{
+    cb->read_addr = read_addr;
+    cb->write_addr = write_addr;
+    cb->transfer_count = transfer_count;
+    cb->ctrl = ctrl;
+}
+
+// Control word for the copies done by the kill, brake and loop control blocks
+static uint32_t sdio_copy_ctrl(sd_card_t *sd_card_p, bool increment, bool chain, bool irq_quiet)
+{
+    dma_channel_config dmacfg = dma_channel_get_default_config(SDIO_DMA_CH);
+    channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&dmacfg, increment);
+    channel_config_set_write_increment(&dmacfg, increment);
+    if (chain)
+        channel_config_set_chain_to(&dmacfg, SDIO_DMA_CHB);
+    channel_config_set_irq_quiet(&dmacfg, irq_quiet);
+    return channel_config_get_ctrl_value(&dmacfg);
+}
+
+// Set up the loop control block after ring_cbs control blocks,
+// and configure the second DMA channel to feed the ring to the first one.
+static void sdio_configure_ring(sd_card_t *sd_card_p, sdio_dma_cb_t *ring, uint32_t ring_cbs)
+{
+    STATE.dma_ring_start = ring;
+    sdio_set_cb(&ring[ring_cbs], &STATE.dma_ring_start, &dma_hw->ch[SDIO_DMA_CHB].read_addr, 1,
+                sdio_copy_ctrl(sd_card_p, false, true, true));
+
+    dma_channel_config dmacfg = dma_channel_get_default_config(SDIO_DMA_CHB);
+    channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&dmacfg, true);
+    channel_config_set_write_increment(&dmacfg, true);
+    channel_config_set_ring(&dmacfg, true, 4);
+    dma_channel_configure(SDIO_DMA_CHB, &dmacfg, &dma_hw->ch[SDIO_DMA_CH].read_addr,
+        ring, sizeof(sdio_dma_cb_t) / sizeof(uint32_t), false);
+}
+
+static void sdio_set_irq_enabled(sd_card_t *sd_card_p, uint channel, bool enabled)
+{
+    switch (sd_card_p->sdio_if_p->DMA_IRQ_num) {
+    case DMA_IRQ_0:
+        // Clear any pending interrupt service request:
+        if (enabled)
+            dma_hw->ints0 = 1 << channel;
+        dma_channel_set_irq0_enabled(channel, enabled);
+        break;
+    case DMA_IRQ_1:
+        // Clear any pending interrupt service request:
+        if (enabled)
+            dma_hw->ints1 = 1 << channel;
+        dma_channel_set_irq1_enabled(channel, enabled);
+        break;
+    default:
+        myASSERT(false);
+    }
+}
+
 /*******************************************************
  * Data reception from SD card
  *******************************************************/
 
 sdio_status_t rp2040_sdio_rx_start(sd_card_t *sd_card_p, uint8_t *buffer, uint32_t num_blocks, size_t block_size)
 {
-    // Buffer must be aligned
-    assert(((uint32_t)buffer & 3) == 0 && num_blocks <= SDIO_MAX_BLOCKS);
+    sd_iovec_t iov = {buffer, num_blocks};
+    return rp2040_sdio_rx_start_v(sd_card_p, &iov, 1, block_size);
+}
+
+// The control blocks for ring slot i are:
+//   rx_ring[i * 3]:     block data, to the buffer
+//   rx_ring[i * 3 + 1]: block checksum, to STATE.block_checksums[i]
+//   rx_ring[i * 3 + 2]: kill, which clears the trigger word of rx_ring[i * 3]
+//                       (or replaces it with the brake) and raises the IRQ
+static sdio_dma_cb_t *sdio_rx_cb(sd_card_t *sd_card_p, uint32_t blockidx)
+{
+    return &STATE.rx_ring[((STATE.ring_base + blockidx) % SDIO_RING_BLOCKS) * 3];
+}
+
+// Point the data control block of a ring slot at the next buffer
+static void sdio_rx_arm(sd_card_t *sd_card_p, sdio_dma_cb_t *cb)
+{
+    cb->read_addr = &SDIO_PIO->rxf[SDIO_DATA_SM];
+    cb->write_addr = sdio_iov_next(&STATE.fill_iter, STATE.block_size);
+    cb->transfer_count = STATE.rx_byte_lanes ? STATE.block_size : STATE.block_size / sizeof(uint32_t);
+    __compiler_memory_barrier();
+    cb->ctrl = STATE.dma_ctrl;
+}
+
+// If any buffer is not aligned, the DMA transfers single bytes,
+// and the PIO pushes each byte as it is received.
+static bool sdio_rx_byte_lanes(const sd_iovec_t *iov, uint32_t iovcnt)
+{
+    for (uint32_t seg = 0; seg < iovcnt; seg++)
+        if (((uint32_t)iov[seg].buffer & 3) != 0)
+            return true;
+    return false;
+}
+
+static void sdio_collect_rx_checksums(sd_card_t *sd_card_p, uint32_t maxcount, size_t block_size_words, bool wait,
+                                      bool late);
+static void sdio_report_rx_checksum_error(sd_card_t *sd_card_p, size_t block_size_words);
+
+// Complete the checks left by a read under the SD_CRC_DEFERRED policy.
+// Called before the next transfer reuses the checksum jobs.
+static void sdio_finish_deferred_checks(sd_card_t *sd_card_p)
+{
+    if (!STATE.rx_checks_deferred)
+        return;
+    STATE.rx_checks_deferred = false;
+    for (uint32_t i = STATE.rx_jobs_collected; i < STATE.rx_jobs_queued; i++)
+        sdio_crc_job_compute(&STATE.rx_jobs[i % SDIO_CRC_QUEUE_LEN]);
+    STATE.checksum_errors = 0;
+    STATE.rx_error_pending = false;
+    while (STATE.rx_jobs_collected < STATE.rx_jobs_queued)
+        sdio_collect_rx_checksums(sd_card_p, SDIO_CRC_QUEUE_LEN, STATE.block_size / sizeof(uint32_t), true, true);
+    sdio_report_rx_checksum_error(sd_card_p, STATE.block_size / sizeof(uint32_t));
+}
 
+static void sdio_rx_begin(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt)
+{
     STATE.transfer_state = SDIO_RX;
     STATE.transfer_start_time = millis();
-    STATE.data_buf = (uint32_t*)buffer;
     STATE.blocks_done = 0;
-    STATE.total_blocks = num_blocks;
+    STATE.total_blocks = sd_iov_blocks(iov, iovcnt);
     STATE.blocks_checksumed = 0;
+    STATE.blocks_queued = 0;
     STATE.checksum_errors = 0;
+    STATE.rx_error_pending = false;
+    STATE.crc_offload = crc_worker.enabled;
+    // Jobs of an aborted read may still be with the worker
+    while (crc_worker.tail != crc_worker.head)
+        tight_loop_contents();
+    STATE.rx_jobs_queued = 0;
+    STATE.rx_jobs_collected = 0;
+    sdio_iov_init(&STATE.fill_iter, iov, iovcnt);
+    sdio_iov_init(&STATE.verify_iter, iov, iovcnt);
+
+    // Fill the ring with the first blocks. The rest are filled in by sdio_rx_refill().
+    for (uint32_t i = 0; i < SDIO_RING_BLOCKS && i < STATE.total_blocks; i++)
+        sdio_rx_arm(sd_card_p, sdio_rx_cb(sd_card_p, i));
+}
 
-    // Create DMA block descriptors to store each block of 512 bytes of data to buffer
-    // and then 8 bytes to STATE.received_checksums.
-    for (uint32_t i = 0; i < num_blocks; i++)
-    {
-        STATE.dma_blocks[i * 2].write_addr = buffer + i * block_size;
-        STATE.dma_blocks[i * 2].transfer_count = block_size / sizeof(uint32_t);
-
-        STATE.dma_blocks[i * 2 + 1].write_addr = &STATE.received_checksums[i];
-        STATE.dma_blocks[i * 2 + 1].transfer_count = 2;
-    }
-    STATE.dma_blocks[num_blocks * 2].write_addr = 0;
-    STATE.dma_blocks[num_blocks * 2].transfer_count = 0;
-
-    // Configure first DMA channel for reading from the PIO RX fifo
+static sdio_status_t sdio_rx_start(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt,
+                                   size_t block_size, bool stream)
+{
+    sdio_finish_deferred_checks(sd_card_p);
+    STATE.rx_byte_lanes = sdio_rx_byte_lanes(iov, iovcnt);
+    STATE.rx_stream = stream;
+    STATE.block_size = block_size;
+    STATE.ring_base = 0;
+    uint32_t xfer_size = STATE.rx_byte_lanes ? 1 : sizeof(uint32_t);
+
+    // Configuration of the first DMA channel for reading from the PIO RX fifo
     dma_channel_config dmacfg = dma_channel_get_default_config(SDIO_DMA_CH);
-    channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
+    channel_config_set_transfer_data_size(&dmacfg, STATE.rx_byte_lanes ? DMA_SIZE_8 : DMA_SIZE_32);
     channel_config_set_read_increment(&dmacfg, false);
     channel_config_set_write_increment(&dmacfg, true);
     channel_config_set_dreq(&dmacfg, pio_get_dreq(SDIO_PIO, SDIO_DATA_SM, false));
-    channel_config_set_bswap(&dmacfg, true);
+    channel_config_set_bswap(&dmacfg, !STATE.rx_byte_lanes);
     channel_config_set_chain_to(&dmacfg, SDIO_DMA_CHB);
-    dma_channel_configure(SDIO_DMA_CH, &dmacfg, 0, &SDIO_PIO->rxf[SDIO_DATA_SM], 0, false);
-
-    // Configure second DMA channel for reconfiguring the first one
-    dmacfg = dma_channel_get_default_config(SDIO_DMA_CHB);
-    channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
-    channel_config_set_read_increment(&dmacfg, true);
-    channel_config_set_write_increment(&dmacfg, true);
-    channel_config_set_ring(&dmacfg, true, 3);
-    dma_channel_configure(SDIO_DMA_CHB, &dmacfg, &dma_hw->ch[SDIO_DMA_CH].al1_write_addr,
-        STATE.dma_blocks, 2, false);
+    channel_config_set_irq_quiet(&dmacfg, true);
+    STATE.dma_ctrl = channel_config_get_ctrl_value(&dmacfg);
+
+    // Create the ring with all slots killed
+    STATE.dma_zero = 0;
+    STATE.pio_sm_mask = 1u << SDIO_CMD_SM | 1u << SDIO_DATA_SM;
+    sdio_set_cb(&STATE.rx_brake, &STATE.pio_sm_mask, hw_clear_alias(&SDIO_PIO->ctrl), 1,
+                sdio_copy_ctrl(sd_card_p, false, false, true));
+    uint32_t kill_ctrl = sdio_copy_ctrl(sd_card_p, stream, true, false);
+    for (uint32_t i = 0; i < SDIO_RING_BLOCKS; i++)
+    {
+        sdio_dma_cb_t *cb = &STATE.rx_ring[i * 3];
+        if (stream)
+        {
+            *cb = STATE.rx_brake;
+            sdio_set_cb(&cb[2], &STATE.rx_brake, &cb[0], sizeof(sdio_dma_cb_t) / sizeof(uint32_t), kill_ctrl);
+        }
+        else
+        {
+            sdio_set_cb(&cb[0], 0, 0, 0, 0);
+            sdio_set_cb(&cb[2], &STATE.dma_zero, &cb[0].ctrl, 1, kill_ctrl);
+        }
+        sdio_set_cb(&cb[1], &SDIO_PIO->rxf[SDIO_DATA_SM], &STATE.block_checksums[i],
+            sizeof(STATE.block_checksums[i]) / xfer_size, STATE.dma_ctrl);
+    }
+    sdio_rx_begin(sd_card_p, iov, iovcnt);
+    sdio_configure_ring(sd_card_p, STATE.rx_ring, SDIO_RING_BLOCKS * 3);
 
     // Initialize PIO state machine
-    pio_sm_init(SDIO_PIO, SDIO_DATA_SM, STATE.pio_data_rx_offset, &STATE.pio_cfg_data_rx);
+    sdio_load_data_program(sd_card_p, &sdio_data_rx_program);
+    pio_sm_config cfg = STATE.pio_cfg_data_rx;
+    if (STATE.rx_byte_lanes)
+    {
+        // Bytes arrive in the low bits of the FIFO word, in the order they were received
+        sm_config_set_in_shift(&cfg, false, true, 8);
+    }
+    pio_sm_init(SDIO_PIO, SDIO_DATA_SM, STATE.pio_data_rx_offset, &cfg);
     pio_sm_set_consecutive_pindirs(SDIO_PIO, SDIO_DATA_SM, SDIO_D0, 4, false);
 
     // Write number of nibbles to receive to Y register
@@ -403,6 +835,9 @@ sdio_status_t rp2040_sdio_rx_start(sd_card_t *sd_card_p, uint8_t *buffer, uint32
     // This gives more leeway for the DMA block switching
     SDIO_PIO->sm[SDIO_DATA_SM].shiftctrl |= PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS;
 
+    // Enable IRQ to trigger at the end of each block, to refill the ring
+    sdio_set_irq_enabled(sd_card_p, SDIO_DMA_CH, true);
+
     // Start PIO and DMA
     dma_channel_start(SDIO_DMA_CHB);
     pio_sm_set_enabled(SDIO_PIO, SDIO_DATA_SM, true);
@@ -410,30 +845,264 @@ sdio_status_t rp2040_sdio_rx_start(sd_card_t *sd_card_p, uint8_t *buffer, uint32
     return SDIO_OK;
 }
 
-// Check checksums for received blocks
+sdio_status_t rp2040_sdio_rx_start_v(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt, size_t block_size)
+{
+    return sdio_rx_start(sd_card_p, iov, iovcnt, block_size, false);
+}
+
+sdio_status_t rp2040_sdio_rx_stream_start(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt)
+{
+    return sdio_rx_start(sd_card_p, iov, iovcnt, SDIO_BLOCK_SIZE, true);
+}
+
+bool rp2040_sdio_rx_stream_more(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt)
+{
+    assert(STATE.rx_stream && STATE.transfer_state == SDIO_IDLE);
+
+    // The DMA transfer size and the PIO configuration can't change in the middle of the stream
+    if (sdio_rx_byte_lanes(iov, iovcnt) != STATE.rx_byte_lanes)
+        return false;
+
+    // The brake is right behind the last block of the previous transfer
+    uint32_t start = millis();
+    while ((SDIO_PIO->ctrl & STATE.pio_sm_mask) || dma_channel_is_busy(SDIO_DMA_CH))
+    {
+        if ((uint32_t)(millis() - start) > sd_timeouts.rp2040_sdio_rx_poll)
+        {
+            EMSG_PRINTF("%s: read stream did not pause\n", __func__);
+            return false;
+        }
+    }
+
+    // The slot with the brake is the first one of this transfer
+    sdio_finish_deferred_checks(sd_card_p);
+    STATE.ring_base = (STATE.ring_base + STATE.total_blocks) % SDIO_RING_BLOCKS;
+    sdio_rx_begin(sd_card_p, iov, iovcnt);
+    sdio_set_irq_enabled(sd_card_p, SDIO_DMA_CH, true);
+
+    // Resume the DMA chain where the brake stopped it, then the bus clock.
+    // Anything received before the brake is still in the RX FIFO.
+    dma_channel_set_read_addr(SDIO_DMA_CHB, sdio_rx_cb(sd_card_p, 0), true);
+    pio_set_sm_mask_enabled(SDIO_PIO, STATE.pio_sm_mask, true);
+    return true;
+}
+
+void rp2040_sdio_rx_stream_end(sd_card_t *sd_card_p)
+{
+    rp2040_sdio_stop(sd_card_p);
+}
+
+// The receive CRC policy of the card applies to data blocks, not registers
+static bool sdio_rx_data(sd_card_t *sd_card_p)
+{
+    return STATE.block_size == SDIO_BLOCK_SIZE;
+}
+
+// Returns false if the CRC of the next received block is not to be checked.
+// Called with interrupts disabled.
+static bool sdio_rx_sample(sd_card_t *sd_card_p)
+{
+    return !sdio_rx_data(sd_card_p) || sd_crc_sample(sd_card_p);
+}
+
+// Under the SD_CRC_DEFERRED policy, received data blocks are only verified
+// as the ring comes round, or when the read completes, except for the last
+// SDIO_RX_DEFERRED_BLOCKS, which are copied and left for
+// sdio_finish_deferred_checks()
+static bool sdio_rx_deferred(sd_card_t *sd_card_p)
+{
+    return SD_CRC_DEFERRED == sd_card_p->rx_crc_policy && sdio_rx_data(sd_card_p);
+}
+
+// late: found by a deferred check, after the read had completed
+// This can be called from the IRQ handler, so it only records the error.
+static void sdio_rx_checksum_error(sd_card_t *sd_card_p, uint32_t blockidx, const uint8_t *data,
+                                   uint64_t checksum, uint64_t expected, bool late)
+{
+    STATE.checksum_errors++;
+    if (sdio_rx_data(sd_card_p))
+        sd_crc_error(sd_card_p, late);
+    if (STATE.checksum_errors == 1)
+    {
+        STATE.rx_error_block = blockidx;
+        STATE.rx_error_data = data;
+        STATE.rx_error_checksum = checksum;
+        STATE.rx_error_expected = expected;
+        STATE.rx_error_late = late;
+        __compiler_memory_barrier();
+        STATE.rx_error_pending = true;
+    }
+}
+
+// Print the first checksum error of a read, once it is over
+static void sdio_report_rx_checksum_error(sd_card_t *sd_card_p, size_t block_size_words)
+{
+    if (!STATE.rx_error_pending)
+        return;
+    STATE.rx_error_pending = false;
+    EMSG_PRINTF("SDIO checksum error in reception%s: block %lu calculated 0x%llx expected 0x%llx\n",
+        STATE.rx_error_late ? " (late)" : "", STATE.rx_error_block,
+        STATE.rx_error_checksum, STATE.rx_error_expected);
+    dump_bytes(block_size_words, (uint8_t *)STATE.rx_error_data);
+}
+
+// Collect the results of the worker for received blocks, in order.
+// If wait is set, wait for the oldest one.
+// Must not be called with interrupts disabled if wait is set.
+static void sdio_collect_rx_checksums(sd_card_t *sd_card_p, uint32_t maxcount, size_t block_size_words, bool wait,
+                                      bool late)
+{
+    while (maxcount-- > 0)
+    {
+        uint32_t save = save_and_disable_interrupts();
+        if (STATE.rx_jobs_collected >= STATE.rx_jobs_queued)
+        {
+            restore_interrupts(save);
+            break;
+        }
+        sdio_crc_job_t *job = &STATE.rx_jobs[STATE.rx_jobs_collected % SDIO_CRC_QUEUE_LEN];
+        if (!job->done)
+        {
+            restore_interrupts(save);
+            if (!wait)
+                break;
+            // The IRQ handler may claim the block meanwhile, so look again
+            while (!job->done)
+                tight_loop_contents();
+            continue;
+        }
+        // Once it is collected, the IRQ handler may reuse the job
+        uint32_t blockidx = job->blockidx;
+        const uint8_t *data = job->data;
+        uint64_t checksum = job->crc;
+        uint64_t expected = job->expected;
+        STATE.rx_jobs_collected++;
+        STATE.blocks_checksumed++;
+        restore_interrupts(save);
+        wait = false;
+        if (checksum != expected)
+            sdio_rx_checksum_error(sd_card_p, blockidx, data, checksum, expected, late);
+    }
+}
+
+// The checksum received with a block, in little-endian format.
+// It is overwritten when the ring slot comes round again.
+static uint64_t sdio_rx_expected(sd_card_t *sd_card_p, uint32_t blockidx)
+{
+    uint32_t slot = (STATE.ring_base + blockidx) % SDIO_RING_BLOCKS;
+    return ((uint64_t)__builtin_bswap32(STATE.block_checksums[slot].top) << 32) |
+           __builtin_bswap32(STATE.block_checksums[slot].bottom);
+}
+
+// Prepare the checksum job of the next received block, without starting it.
+// The checksum received with the block is copied, so its ring slot is free.
+// Called with interrupts disabled.
+static sdio_crc_job_t *sdio_rx_job(sd_card_t *sd_card_p, uint32_t blockidx, const uint8_t *data)
+{
+    sdio_crc_job_t *job = &STATE.rx_jobs[STATE.rx_jobs_queued++ % SDIO_CRC_QUEUE_LEN];
+    job->data = data;
+    job->num_words = STATE.block_size / sizeof(uint32_t);
+    job->blockidx = blockidx;
+    job->expected = sdio_rx_expected(sd_card_p, blockidx);
+    job->done = false;
+    return job;
+}
+
+// Hand the blocks that have landed to the worker, along with the checksums
+// received with them, before the ring slots are reused.
+// If the worker has fallen a whole queue of jobs behind, check the block
+// here instead, so that the ring never waits for the worker.
+// Called with interrupts disabled.
+static void sdio_queue_rx_checksums(sd_card_t *sd_card_p)
+{
+    while (STATE.blocks_queued < STATE.blocks_done)
+    {
+        uint32_t blockidx = STATE.blocks_queued++;
+        const uint8_t *data = sdio_iov_next(&STATE.verify_iter, STATE.block_size);
+        if (!sdio_rx_sample(sd_card_p))
+        {
+            STATE.blocks_checksumed++;
+            continue;
+        }
+        if (STATE.rx_jobs_queued - STATE.rx_jobs_collected >= SDIO_CRC_QUEUE_LEN)
+            sdio_collect_rx_checksums(sd_card_p, 1, STATE.block_size / sizeof(uint32_t), false, false);
+        if (STATE.rx_jobs_queued - STATE.rx_jobs_collected < SDIO_CRC_QUEUE_LEN)
+        {
+            sdio_crc_job_t *job = sdio_rx_job(sd_card_p, blockidx, data);
+            sdio_crc_submit(job, data, job->num_words);
+            continue;
+        }
+        uint64_t expected = sdio_rx_expected(sd_card_p, blockidx);
+        uint64_t checksum = sdio_block_checksum(data, STATE.block_size / sizeof(uint32_t));
+        STATE.blocks_checksumed++;
+        if (checksum != expected)
+            sdio_rx_checksum_error(sd_card_p, blockidx, data, checksum, expected, false);
+    }
+}
+
+// Check checksums for received blocks.
+// This is called from both rx_poll() and the IRQ handler,
+// so each block is claimed with interrupts disabled.
 static void sdio_verify_rx_checksums(sd_card_t *sd_card_p, uint32_t maxcount, size_t block_size_words)
 {
-    while (STATE.blocks_checksumed < STATE.blocks_done && maxcount-- > 0)
+    if (STATE.crc_offload)
     {
-        // Calculate checksum from received data
-        int blockidx = STATE.blocks_checksumed++;
-        uint64_t checksum = sdio_crc16_4bit_checksum(STATE.data_buf + blockidx * block_size_words,
-                                                     block_size_words);
+        sdio_collect_rx_checksums(sd_card_p, maxcount, block_size_words, false, false);
+        return;
+    }
+    while (maxcount-- > 0)
+    {
+        uint32_t save = save_and_disable_interrupts();
+        if (STATE.blocks_checksumed >= STATE.blocks_done)
+        {
+            restore_interrupts(save);
+            break;
+        }
+        uint32_t blockidx = STATE.blocks_checksumed++;
+        const uint8_t *data = sdio_iov_next(&STATE.verify_iter, STATE.block_size);
 
         // Convert received checksum to little-endian format
-        uint32_t top = __builtin_bswap32(STATE.received_checksums[blockidx].top);
-        uint32_t bottom = __builtin_bswap32(STATE.received_checksums[blockidx].bottom);
+        // (It is overwritten when the ring slot comes round again.)
+        uint32_t slot = (STATE.ring_base + blockidx) % SDIO_RING_BLOCKS;
+        uint32_t top = __builtin_bswap32(STATE.block_checksums[slot].top);
+        uint32_t bottom = __builtin_bswap32(STATE.block_checksums[slot].bottom);
+        bool sample = sdio_rx_sample(sd_card_p);
+        restore_interrupts(save);
+        if (!sample)
+            continue;
         uint64_t expected = ((uint64_t)top << 32) | bottom;
 
+        // Calculate checksum from received data
+        uint64_t checksum = sdio_block_checksum(data, block_size_words);
+
         if (checksum != expected)
+            sdio_rx_checksum_error(sd_card_p, blockidx, data, checksum, expected, false);
+    }
+}
+
+// Count the blocks that have been received and refill their ring slots.
+// A block has been received when the kill control block of its slot has run.
+static void sdio_rx_refill(sd_card_t *sd_card_p)
+{
+    while (STATE.blocks_done < STATE.total_blocks)
+    {
+        uint32_t blockidx = STATE.blocks_done;
+        sdio_dma_cb_t *cb = sdio_rx_cb(sd_card_p, blockidx);
+        if (cb->ctrl == STATE.dma_ctrl)
+            break;
+        if (blockidx + SDIO_RING_BLOCKS < STATE.total_blocks)
+            sdio_rx_arm(sd_card_p, cb);
+        STATE.blocks_done++;
+
+        if (STATE.crc_offload)
         {
-            STATE.checksum_errors++;
-            if (STATE.checksum_errors == 1)
-            {
-                EMSG_PRINTF("SDIO checksum error in reception: block %d calculated 0x%llx expected 0x%llx\n",
-                    blockidx, checksum, expected);
-                dump_bytes(block_size_words, (uint8_t *)STATE.data_buf + blockidx * block_size_words);
-            }
+            sdio_queue_rx_checksums(sd_card_p);
+        }
+        // If rx_poll() is falling behind, verify the oldest block
+        // before the next block overwrites its checksum.
+        else if (STATE.blocks_checksumed + SDIO_RING_BLOCKS - 1 < STATE.blocks_done)
+        {
+            sdio_verify_rx_checksums(sd_card_p, 1, STATE.block_size / sizeof(uint32_t));
         }
     }
 }
@@ -444,19 +1113,20 @@ sdio_status_t rp2040_sdio_rx_poll(sd_card_t *sd_card_p, size_t block_size_words)
     if (STATE.blocks_done >= STATE.total_blocks)
     {
         STATE.transfer_state = SDIO_IDLE;
+        sdio_set_irq_enabled(sd_card_p, SDIO_DMA_CH, false);
     }
     else
     {
-        // Use the idle time to calculate checksums
-        sdio_verify_rx_checksums(sd_card_p, 4, block_size_words);
-
-        // Check how many DMA control blocks have been consumed
-        uint32_t dma_ctrl_block_count = (dma_hw->ch[SDIO_DMA_CHB].read_addr - (uint32_t)&STATE.dma_blocks);
-        dma_ctrl_block_count /= sizeof(STATE.dma_blocks[0]);
+        // Normally the IRQ handler verifies the checksums as blocks land.
+        // Otherwise, use the idle time to calculate them.
+        if (!sdio_rx_deferred(sd_card_p))
+            sdio_verify_rx_checksums(sd_card_p, 4, block_size_words);
 
-        // Compute how many complete SDIO blocks have been transferred
-        // When transfer ends, dma_ctrl_block_count == STATE.total_blocks * 2 + 1
-        STATE.blocks_done = (dma_ctrl_block_count - 1) / 2;
+        // Normally the IRQ handler keeps the ring filled, but it might not
+        // get to run, e.g. if this is called from a higher priority handler.
+        uint32_t save = save_and_disable_interrupts();
+        sdio_rx_refill(sd_card_p);
+        restore_interrupts(save);
 
         // NOTE: When all blocks are done, rx_poll() still returns SDIO_BUSY once.
         // This provides a chance to start the SCSI transfer before the last checksums
@@ -467,8 +1137,38 @@ sdio_status_t rp2040_sdio_rx_poll(sd_card_t *sd_card_p, size_t block_size_words)
     if (STATE.transfer_state == SDIO_IDLE)
     {
         // Verify all remaining checksums.
-        sdio_verify_rx_checksums(sd_card_p, STATE.total_blocks, block_size_words);
+        if (sdio_rx_deferred(sd_card_p) && !STATE.crc_offload)
+        {
+            // Verify all but the last few now. Copy those, since the caller
+            // may reuse the buffer, and leave them for sdio_finish_deferred_checks().
+            // Without the worker, the jobs aren't used during the read,
+            // and verify_iter points at the oldest unverified block.
+            if (STATE.total_blocks - STATE.blocks_checksumed > SDIO_RX_DEFERRED_BLOCKS)
+                sdio_verify_rx_checksums(sd_card_p, STATE.total_blocks - STATE.blocks_checksumed - SDIO_RX_DEFERRED_BLOCKS,
+                                         block_size_words);
+            for (uint32_t blockidx = STATE.blocks_checksumed; blockidx < STATE.total_blocks; blockidx++)
+            {
+                myASSERT(STATE.rx_jobs_queued < SDIO_RX_DEFERRED_BLOCKS);
+                uint32_t *copy = STATE.rx_deferred_bufs[STATE.rx_jobs_queued];
+                memcpy(copy, sdio_iov_next(&STATE.verify_iter, STATE.block_size), STATE.block_size);
+                sdio_rx_job(sd_card_p, blockidx, (const uint8_t *)copy);
+                sd_crc_sample(sd_card_p);  // Counts it as checked
+            }
+            STATE.rx_checks_deferred = STATE.rx_jobs_collected < STATE.rx_jobs_queued;
+        }
+        else if (STATE.crc_offload)
+        {
+            // The worker is reading the caller's buffers, so even deferred
+            // checks are waited for
+            while (STATE.blocks_checksumed < STATE.total_blocks)
+                sdio_collect_rx_checksums(sd_card_p, STATE.total_blocks, block_size_words, true, false);
+        }
+        else
+        {
+            sdio_verify_rx_checksums(sd_card_p, STATE.total_blocks, block_size_words);
+        }
 
+        sdio_report_rx_checksum_error(sd_card_p, block_size_words);
         if (STATE.checksum_errors == 0)
             return SDIO_OK;
         else
@@ -493,93 +1193,204 @@ sdio_status_t rp2040_sdio_rx_poll(sd_card_t *sd_card_p, size_t block_size_words)
  * Data transmission to SD card
  *******************************************************/
 
-static void sdio_start_next_block_tx(sd_card_t *sd_card_p)
+// Block header for the sdio_data_tx program: number of nibbles to send minus 1
+// (start token, data and CRC) in the top 20 bits, followed by the start token.
+// It is byte swapped because the DMA swaps everything it sends.
+#define SDIO_TX_BLOCK_NIBBLES (3 + SDIO_BLOCK_SIZE * 2 + 16)
+#define SDIO_TX_BLOCK_HEADER __builtin_bswap32(((uint32_t)(SDIO_TX_BLOCK_NIBBLES - 1) << 12) | 0xFF0)
+
+// The control blocks for ring slot i are:
+//   tx_ring[i * 4]:     block header
+//   tx_ring[i * 4 + 1]: block data
+//   tx_ring[i * 4 + 2]: block checksum, from STATE.block_checksums[i]
+//   tx_ring[i * 4 + 3]: kill, which clears the trigger word of tx_ring[i * 4]
+// The trigger word of the header control block is left zero until the checksum
+// for the block has been computed. If the DMA gets there first, the chain
+// stops between blocks, where the state machine is waiting for the next header
+// with the data bus released, and sdio_arm_next_tx_block() restarts it.
+//
+// A ring slot is reused once the card has accepted the block that was in it.
+// A block in an unaligned buffer is first copied to a bounce buffer,
+// which is reused in the same way.
+
+// Place the next block in its ring slot and start its checksum:
+// on core 1, if the worker is enabled, otherwise right away.
+// Returns false if the slot or the bounce buffer is still busy.
+static bool sdio_place_next_tx_block(sd_card_t *sd_card_p)
 {
-    // Initialize PIO
-    pio_sm_init(SDIO_PIO, SDIO_DATA_SM, STATE.pio_data_tx_offset, &STATE.pio_cfg_data_tx);
-    
-    // Configure DMA to send the data block payload (512 bytes)
-    dma_channel_config dmacfg = dma_channel_get_default_config(SDIO_DMA_CH);
-    channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
-    channel_config_set_read_increment(&dmacfg, true);
-    channel_config_set_write_increment(&dmacfg, false);
-    channel_config_set_dreq(&dmacfg, pio_get_dreq(SDIO_PIO, SDIO_DATA_SM, true));
-    channel_config_set_bswap(&dmacfg, true);
-    channel_config_set_chain_to(&dmacfg, SDIO_DMA_CHB);
-    dma_channel_configure(SDIO_DMA_CH, &dmacfg,
-        &SDIO_PIO->txf[SDIO_DATA_SM], STATE.data_buf + STATE.blocks_done * SDIO_WORDS_PER_BLOCK,
-        SDIO_WORDS_PER_BLOCK, false);
-
-    // Prepare second DMA channel to send the CRC and block end marker
-    uint64_t crc = STATE.next_wr_block_checksum;
-    STATE.end_token_buf[0] = (uint32_t)(crc >> 32);
-    STATE.end_token_buf[1] = (uint32_t)(crc >>  0);
-    STATE.end_token_buf[2] = 0xFFFFFFFF;
-    channel_config_set_bswap(&dmacfg, false);
-    dma_channel_configure(SDIO_DMA_CHB, &dmacfg,
-        &SDIO_PIO->txf[SDIO_DATA_SM], STATE.end_token_buf, 3, false);
-
-    // Enable IRQ to trigger when block is done
-    switch (sd_card_p->sdio_if_p->DMA_IRQ_num) {
-        case DMA_IRQ_0:
-            // Clear any pending interrupt service request:
-            dma_hw->ints0 = 1 << SDIO_DMA_CHB;
-            dma_channel_set_irq0_enabled(SDIO_DMA_CHB, true);
-            break;
-        case DMA_IRQ_1:
-            // Clear any pending interrupt service request:
-            dma_hw->ints1 = 1 << SDIO_DMA_CHB;
-            dma_channel_set_irq1_enabled(SDIO_DMA_CHB, true);
-            break;
-        default:
-            assert(false);
+    if (STATE.blocks_queued >= STATE.total_blocks)
+    {
+        return false;
+    }
+    uint32_t blockidx = STATE.blocks_queued;
+    const uint8_t *data = STATE.fill_iter.buf;
+    bool bounce = ((uint32_t)data & 3) != 0;
+    uint32_t depth = bounce && SDIO_TX_BOUNCE_BLOCKS < SDIO_RING_BLOCKS ? SDIO_TX_BOUNCE_BLOCKS : SDIO_RING_BLOCKS;
+    if (blockidx >= STATE.blocks_done + depth)
+    {
+        return false;
+    }
+    sdio_iov_next(&STATE.fill_iter, SDIO_BLOCK_SIZE);
+    if (bounce)
+    {
+        uint32_t *bounce_buf = STATE.tx_bounce_bufs[blockidx % SDIO_TX_BOUNCE_BLOCKS];
+        memcpy(bounce_buf, data, SDIO_BLOCK_SIZE);
+        data = (const uint8_t *)bounce_buf;
     }
+    STATE.blocks_queued++;
 
-    // Initialize register X with nibble count and register Y with response bit count
-    pio_sm_put(SDIO_PIO, SDIO_DATA_SM, 1048);
-    pio_sm_exec(SDIO_PIO, SDIO_DATA_SM, pio_encode_out(pio_x, 32));
-    pio_sm_put(SDIO_PIO, SDIO_DATA_SM, 31);
-    pio_sm_exec(SDIO_PIO, SDIO_DATA_SM, pio_encode_out(pio_y, 32));
-    
-    // Initialize pins to output and high
-    pio_sm_exec(SDIO_PIO, SDIO_DATA_SM, pio_encode_set(pio_pins, 15));
-    pio_sm_exec(SDIO_PIO, SDIO_DATA_SM, pio_encode_set(pio_pindirs, 15));
+    uint32_t slot = blockidx % SDIO_RING_BLOCKS;
+    STATE.tx_ring[slot * 4 + 1].read_addr = data;
+    if (STATE.crc_offload)
+    {
+        sdio_crc_submit(&STATE.crc_jobs[slot], data, SDIO_WORDS_PER_BLOCK);
+    }
+    else
+    {
+        STATE.crc_jobs[slot].crc = sdio_crc16_4bit_checksum((uint32_t *)data, SDIO_WORDS_PER_BLOCK);
+        STATE.crc_jobs[slot].done = true;
+    }
+    return true;
+}
 
-    // Write start token and start the DMA transfer.
-    pio_sm_put(SDIO_PIO, SDIO_DATA_SM, 0xFFFFFFF0);
-    dma_channel_start(SDIO_DMA_CH);
-    
-    // Start state machine
-    pio_sm_set_enabled(SDIO_PIO, SDIO_DATA_SM, true);
+// Arm the header of the next placed block, once its checksum is ready.
+// Returns false if there is none.
+static bool sdio_arm_next_tx_block(sd_card_t *sd_card_p)
+{
+    if (STATE.blocks_checksumed >= STATE.blocks_queued)
+    {
+        return false;
+    }
+    uint32_t blockidx = STATE.blocks_checksumed;
+    uint32_t slot = blockidx % SDIO_RING_BLOCKS;
+    if (!STATE.crc_jobs[slot].done)
+    {
+        return false;
+    }
+    STATE.blocks_checksumed++;
+
+    uint64_t crc = STATE.crc_jobs[slot].crc;
+    STATE.block_checksums[slot].top = __builtin_bswap32((uint32_t)(crc >> 32));
+    STATE.block_checksums[slot].bottom = __builtin_bswap32((uint32_t)(crc >> 0));
+
+    sdio_dma_cb_t *cb = &STATE.tx_ring[slot * 4];
+
+    // Make sure the data address and checksum are in memory before the DMA can get to them
+    __compiler_memory_barrier();
+    cb[0].ctrl = STATE.dma_ctrl;
+    __compiler_memory_barrier();
+
+    // Did the DMA chain stop at this header?
+    // (If the second channel is loading it right now, let it finish first.)
+    while (dma_channel_is_busy(SDIO_DMA_CHB))
+        tight_loop_contents();
+    if (blockidx > 0 &&
+        dma_hw->ch[SDIO_DMA_CHB].read_addr == (uint32_t)&cb[1] &&
+        !(dma_hw->ch[SDIO_DMA_CH].al1_ctrl & DMA_CH0_CTRL_TRIG_EN_BITS) &&
+        !dma_channel_is_busy(SDIO_DMA_CH))
+    {
+        dma_channel_set_read_addr(SDIO_DMA_CHB, &cb[0], true);
+    }
+    return true;
 }
 
-static void sdio_compute_next_tx_checksum(sd_card_t *sd_card_p)
+// Keep the checksums ahead of the DMA.
+// With the worker, every free ring slot is placed at once, so that core 1
+// works through them while core 0 only arms the headers.
+// Returns false if no block could be armed.
+static bool sdio_compute_next_tx_checksum(sd_card_t *sd_card_p)
 {
-    assert (STATE.blocks_done < STATE.total_blocks && STATE.blocks_checksumed < STATE.total_blocks);
-    int blockidx = STATE.blocks_checksumed++;
-    STATE.next_wr_block_checksum = sdio_crc16_4bit_checksum(STATE.data_buf + blockidx * SDIO_WORDS_PER_BLOCK,
-                                                             SDIO_WORDS_PER_BLOCK);
+    if (STATE.crc_offload)
+    {
+        while (sdio_place_next_tx_block(sd_card_p))
+            ;
+    }
+    else if (STATE.blocks_queued == STATE.blocks_checksumed)
+    {
+        sdio_place_next_tx_block(sd_card_p);
+    }
+    return sdio_arm_next_tx_block(sd_card_p);
 }
 
 // Start transferring data from memory to SD card
 sdio_status_t rp2040_sdio_tx_start(sd_card_t *sd_card_p, const uint8_t *buffer, uint32_t num_blocks)
 {
-    // Buffer must be aligned
-    assert(((uint32_t)buffer & 3) == 0 && num_blocks <= SDIO_MAX_BLOCKS);
+    sd_iovec_t iov = {(uint8_t *)buffer, num_blocks};
+    return rp2040_sdio_tx_start_v(sd_card_p, &iov, 1);
+}
+
+sdio_status_t rp2040_sdio_tx_start_v(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt)
+{
+    sdio_finish_deferred_checks(sd_card_p);
+    uint32_t num_blocks = sd_iov_blocks(iov, iovcnt);
 
     STATE.transfer_state = SDIO_TX;
     STATE.transfer_start_time = millis();
-    STATE.data_buf = (uint32_t*)buffer;
     STATE.blocks_done = 0;
     STATE.total_blocks = num_blocks;
     STATE.blocks_checksumed = 0;
+    STATE.blocks_queued = 0;
     STATE.checksum_errors = 0;
+    STATE.crc_offload = crc_worker.enabled;
+    STATE.wr_status = SDIO_OK;
+    STATE.block_size = SDIO_BLOCK_SIZE;
+    sdio_iov_init(&STATE.fill_iter, iov, iovcnt);
+
+    // Configuration of the first DMA channel to send from memory to the PIO TX fifo
+    dma_channel_config dmacfg = dma_channel_get_default_config(SDIO_DMA_CH);
+    channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&dmacfg, true);
+    channel_config_set_write_increment(&dmacfg, false);
+    channel_config_set_dreq(&dmacfg, pio_get_dreq(SDIO_PIO, SDIO_DATA_SM, true));
+    channel_config_set_bswap(&dmacfg, true);
+    channel_config_set_chain_to(&dmacfg, SDIO_DMA_CHB);
+    channel_config_set_irq_quiet(&dmacfg, true);
+    STATE.dma_ctrl = channel_config_get_ctrl_value(&dmacfg);
+    uint32_t kill_ctrl = sdio_copy_ctrl(sd_card_p, false, true, true);
+
+    // Create the ring with all headers unarmed
+    STATE.dma_zero = 0;
+    STATE.tx_block_header = SDIO_TX_BLOCK_HEADER;
+    for (uint32_t i = 0; i < SDIO_RING_BLOCKS; i++)
+    {
+        sdio_dma_cb_t *cb = &STATE.tx_ring[i * 4];
+        sdio_set_cb(&cb[0], &STATE.tx_block_header, &SDIO_PIO->txf[SDIO_DATA_SM], 1, 0);
+        sdio_set_cb(&cb[1], 0, &SDIO_PIO->txf[SDIO_DATA_SM], SDIO_WORDS_PER_BLOCK, STATE.dma_ctrl);
+        sdio_set_cb(&cb[2], &STATE.block_checksums[i], &SDIO_PIO->txf[SDIO_DATA_SM], 2, STATE.dma_ctrl);
+        sdio_set_cb(&cb[3], &STATE.dma_zero, &cb[0].ctrl, 1, kill_ctrl);
+    }
+    sdio_configure_ring(sd_card_p, STATE.tx_ring, SDIO_RING_BLOCKS * 4);
+
+    // Compute first block checksum. The chain can't be restarted at the
+    // first header, so it must be armed before the DMA starts.
+    while (!sdio_compute_next_tx_checksum(sd_card_p))
+        tight_loop_contents();
+
+    // Initialize PIO
+    sdio_load_data_program(sd_card_p, &sdio_data_tx_program);
+    pio_sm_init(SDIO_PIO, SDIO_DATA_SM, STATE.pio_data_tx_offset, &STATE.pio_cfg_data_tx);
 
-    // Compute first block checksum
-    sdio_compute_next_tx_checksum(sd_card_p);
+    // Initialize pins to high. The program sets them to output for each block.
+    pio_sm_exec(SDIO_PIO, SDIO_DATA_SM, pio_encode_set(pio_pins, 15));
+
+    // Configure third DMA channel to collect the card response for each block
+    // (into the ring of the last SDIO_RING_BLOCKS responses)
+    dmacfg = dma_channel_get_default_config(SDIO_DMA_CHC);
+    channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&dmacfg, false);
+    channel_config_set_write_increment(&dmacfg, true);
+    channel_config_set_ring(&dmacfg, true, __builtin_ctz(sizeof(STATE.card_responses)));
+    channel_config_set_dreq(&dmacfg, pio_get_dreq(SDIO_PIO, SDIO_DATA_SM, false));
+    dma_channel_configure(SDIO_DMA_CHC, &dmacfg, STATE.card_responses,
+        &SDIO_PIO->rxf[SDIO_DATA_SM], num_blocks, false);
 
-    // Start first DMA transfer and PIO
-    sdio_start_next_block_tx(sd_card_p);
+    // Enable IRQ to trigger when all responses are in
+    sdio_set_irq_enabled(sd_card_p, SDIO_DMA_CHC, true);
+
+    // Start DMA and PIO
+    dma_channel_start(SDIO_DMA_CHC);
+    dma_channel_start(SDIO_DMA_CHB);
+    pio_sm_set_enabled(SDIO_PIO, SDIO_DATA_SM, true);
 
     if (STATE.blocks_checksumed < STATE.total_blocks)
     {
@@ -625,64 +1436,42 @@ static sdio_status_t check_sdio_write_response(uint32_t card_response)
     }
 }
 
-// When a block finishes, this IRQ handler starts the next one
+// Check the card responses that have arrived since the last call
+static void sdio_check_tx_responses(sd_card_t *sd_card_p)
+{
+    uint32_t blocks_done = STATE.total_blocks - dma_hw->ch[SDIO_DMA_CHC].transfer_count;
+    while (STATE.blocks_done < blocks_done && STATE.wr_status == SDIO_OK)
+    {
+        STATE.wr_status = check_sdio_write_response(STATE.card_responses[STATE.blocks_done % SDIO_RING_BLOCKS]);
+        if (STATE.wr_status == SDIO_OK)
+            STATE.blocks_done++;
+    }
+}
+
+// During a read, this IRQ handler is called at the end of each block to refill the ring.
+// During a write, when the response for the last block arrives, it ends the transfer.
 void sdio_irq_handler(sd_card_t *sd_card_p) {
-    if (STATE.transfer_state == SDIO_TX)
+    if (STATE.transfer_state == SDIO_RX)
     {
-        if (!dma_channel_is_busy(SDIO_DMA_CH) && !dma_channel_is_busy(SDIO_DMA_CHB))
+        sdio_rx_refill(sd_card_p);
+
+        // Verify the blocks as they land, so that the waiting core is free to sleep.
+        // When the last one is done, the transfer is complete: wake up the waiter.
+        // Deferred checks are left for later, so the last block landing is enough.
+        bool deferred = sdio_rx_deferred(sd_card_p);
+        if (!deferred)
+            sdio_verify_rx_checksums(sd_card_p, STATE.total_blocks, STATE.block_size / sizeof(uint32_t));
+        if ((deferred ? STATE.blocks_done : STATE.blocks_checksumed) >= STATE.total_blocks)
         {
-            // Main data transfer is finished now.
-            // When card is ready, PIO will put card response on RX fifo
-            STATE.transfer_state = SDIO_TX_WAIT_IDLE;
-            if (!pio_sm_is_rx_fifo_empty(SDIO_PIO, SDIO_DATA_SM))
-            {
-                // Card is already idle
-                STATE.card_response = pio_sm_get(SDIO_PIO, SDIO_DATA_SM);
-            }
-            else
-            {
-                // Use DMA to wait for the response
-                dma_channel_config dmacfg = dma_channel_get_default_config(SDIO_DMA_CHB);
-                channel_config_set_transfer_data_size(&dmacfg, DMA_SIZE_32);
-                channel_config_set_read_increment(&dmacfg, false);
-                channel_config_set_write_increment(&dmacfg, false);
-                channel_config_set_dreq(&dmacfg, pio_get_dreq(SDIO_PIO, SDIO_DATA_SM, false));
-                dma_channel_configure(SDIO_DMA_CHB, &dmacfg,
-                    &STATE.card_response, &SDIO_PIO->rxf[SDIO_DATA_SM], 1, true);
-            }
+            STATE.transfer_state = SDIO_IDLE;
+            sdio_set_irq_enabled(sd_card_p, SDIO_DMA_CH, false);
+            __sev();
         }
     }
-    
-    if (STATE.transfer_state == SDIO_TX_WAIT_IDLE)
+    else if (STATE.transfer_state == SDIO_TX && !dma_channel_is_busy(SDIO_DMA_CHC))
     {
-        if (!dma_channel_is_busy(SDIO_DMA_CHB))
-        {
-            STATE.wr_status = check_sdio_write_response(STATE.card_response);
-
-            if (STATE.wr_status != SDIO_OK)
-            {
-                rp2040_sdio_stop(sd_card_p);
-                return;
-            }
-
-            STATE.blocks_done++;
-            if (STATE.blocks_done < STATE.total_blocks)
-            {
-                sdio_start_next_block_tx(sd_card_p);
-                STATE.transfer_state = SDIO_TX;
-
-                if (STATE.blocks_checksumed < STATE.total_blocks)
-                {
-                    // Precompute the CRC for next block so that it is ready when
-                    // we want to send it.
-                    sdio_compute_next_tx_checksum(sd_card_p);
-                }
-            }
-            else
-            {
-                rp2040_sdio_stop(sd_card_p);
-            }
-        }    
+        sdio_check_tx_responses(sd_card_p);
+        rp2040_sdio_stop(sd_card_p);
     }
 }
 
@@ -697,6 +1486,25 @@ sdio_status_t rp2040_sdio_tx_poll(sd_card_t *sd_card_p, uint32_t *bytes_complete
     }
 #endif
 
+    if (STATE.transfer_state == SDIO_TX)
+    {
+        // Stop early if the card has rejected a block
+        sdio_check_tx_responses(sd_card_p);
+        if (STATE.wr_status != SDIO_OK)
+        {
+            rp2040_sdio_stop(sd_card_p);
+        }
+        else
+        {
+            // Use the idle time to calculate checksums ahead of the DMA
+            for (int i = 0; i < 4 && STATE.blocks_checksumed < STATE.total_blocks; i++)
+            {
+                if (!sdio_compute_next_tx_checksum(sd_card_p))
+                    break;
+            }
+        }
+    }
+
     if (bytes_complete)
     {
         *bytes_complete = STATE.blocks_done * SDIO_BLOCK_SIZE;
@@ -732,23 +1540,30 @@ static sdio_status_t rp2040_sdio_stop(sd_card_t *sd_card_p)
 {
     dma_channel_abort(SDIO_DMA_CH);
     dma_channel_abort(SDIO_DMA_CHB);
-    switch (sd_card_p->sdio_if_p->DMA_IRQ_num) {
-    case DMA_IRQ_0:
-            dma_channel_set_irq0_enabled(SDIO_DMA_CHB, false);
-        break;
-    case DMA_IRQ_1:
-            dma_channel_set_irq1_enabled(SDIO_DMA_CHB, false);
-        break;
-    default:
-        myASSERT(false);
-    }
+    dma_channel_abort(SDIO_DMA_CHC);
+    sdio_set_irq_enabled(sd_card_p, SDIO_DMA_CH, false);
+    sdio_set_irq_enabled(sd_card_p, SDIO_DMA_CHC, false);
 
     pio_sm_set_enabled(SDIO_PIO, SDIO_DATA_SM, false);
     pio_sm_set_consecutive_pindirs(SDIO_PIO, SDIO_DATA_SM, SDIO_D0, 4, false);    
+    // Restart the bus clock, in case a read stream paused it
+    pio_sm_set_enabled(SDIO_PIO, SDIO_CMD_SM, true);
+    STATE.rx_stream = false;
     STATE.transfer_state = SDIO_IDLE;
     return SDIO_OK;
 }
 
+void rp2040_sdio_set_clk_div(sd_card_t *sd_card_p, float clk_div)
+{
+    assert(STATE.transfer_state == SDIO_IDLE);
+    sm_config_set_clkdiv(&STATE.pio_cfg_data_rx, clk_div);
+    sm_config_set_clkdiv(&STATE.pio_cfg_data_tx, clk_div);
+    pio_sm_set_clkdiv(SDIO_PIO, SDIO_CMD_SM, clk_div);
+    pio_sm_set_clkdiv(SDIO_PIO, SDIO_DATA_SM, clk_div);
+    // Keep the data state machine in phase with the clock
+    pio_clkdiv_restart_sm_mask(SDIO_PIO, 1u << SDIO_CMD_SM | 1u << SDIO_DATA_SM);
+}
+
 bool rp2040_sdio_init(sd_card_t *sd_card_p, float clk_div) {
     // Mark resources as being in use, unless it has been done already.
     if (!STATE.resources_claimed) {
@@ -767,16 +1582,23 @@ bool rp2040_sdio_init(sd_card_t *sd_card_p, float clk_div) {
         SDIO_DMA_CH = dma_claim_unused_channel(true);
         // dma_channel_claim(SDIO_DMA_CHB);
         SDIO_DMA_CHB = dma_claim_unused_channel(true);
+        SDIO_DMA_CHC = dma_claim_unused_channel(true);
 
-        /* Set up IRQ handler for when DMA completes. */
+        /* Set up IRQ handler for when DMA completes.
+        Data channel for reads, response channel for writes. */
         dma_irq_add_handler(sd_card_p->sdio_if_p->DMA_IRQ_num,
-                            sd_card_p->sdio_if_p->use_exclusive_DMA_IRQ_handler);
+                            sd_card_p->sdio_if_p->use_exclusive_DMA_IRQ_handler,
+                            1u << SDIO_DMA_CH | 1u << SDIO_DMA_CHC,
+                            sdio_irq_handler, sd_card_p);
 
         STATE.resources_claimed = true;
     }
+    // The buffers of a read before reinitialization are gone
+    STATE.rx_checks_deferred = false;
 
     dma_channel_abort(SDIO_DMA_CH);
     dma_channel_abort(SDIO_DMA_CHB);
+    dma_channel_abort(SDIO_DMA_CHC);
     pio_sm_set_enabled(SDIO_PIO, SDIO_CMD_SM, false);
     pio_sm_set_enabled(SDIO_PIO, SDIO_DATA_SM, false);
 
@@ -800,8 +1622,13 @@ bool rp2040_sdio_init(sd_card_t *sd_card_p, float clk_div) {
     pio_sm_set_consecutive_pindirs(SDIO_PIO, SDIO_CMD_SM, SDIO_CLK, 1, true);
     pio_sm_set_enabled(SDIO_PIO, SDIO_CMD_SM, true);
 
+    // Data transmission and reception programs share the same instruction memory.
+    // The transmission program is the longer one, so load it first to reserve the space.
+    STATE.pio_data_tx_offset = pio_add_program(SDIO_PIO, &sdio_data_tx_program);
+    STATE.pio_data_rx_offset = STATE.pio_data_tx_offset;
+    STATE.pio_data_program = &sdio_data_tx_program;
+
     // Data reception program
-    STATE.pio_data_rx_offset = pio_add_program(SDIO_PIO, &sdio_data_rx_program);
     STATE.pio_cfg_data_rx = sdio_data_rx_program_get_default_config(STATE.pio_data_rx_offset);
     sm_config_set_in_pins(&STATE.pio_cfg_data_rx, SDIO_D0);
     sm_config_set_in_shift(&STATE.pio_cfg_data_rx, false, true, 32);
@@ -809,7 +1636,6 @@ bool rp2040_sdio_init(sd_card_t *sd_card_p, float clk_div) {
     sm_config_set_clkdiv(&STATE.pio_cfg_data_rx, clk_div);
 
     // Data transmission program
-    STATE.pio_data_tx_offset = pio_add_program(SDIO_PIO, &sdio_data_tx_program);
     STATE.pio_cfg_data_tx = sdio_data_tx_program_get_default_config(STATE.pio_data_tx_offset);
     sm_config_set_in_pins(&STATE.pio_cfg_data_tx, SDIO_D0);
     sm_config_set_set_pins(&STATE.pio_cfg_data_tx, SDIO_D0, 4);
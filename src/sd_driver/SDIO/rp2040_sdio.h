@@ -14,6 +14,7 @@ extern "C" {
 
 //FIXME: why?
 typedef struct sd_card_t sd_card_t;
+typedef struct sd_iovec_t sd_iovec_t;
 
 typedef
 enum sdio_status_t {
@@ -31,10 +32,72 @@ enum sdio_status_t {
 #define SDIO_BLOCK_SIZE 512
 #define SDIO_WORDS_PER_BLOCK (SDIO_BLOCK_SIZE / 4) // 128
 
-// Maximum number of 512 byte blocks to transfer in one request
-#define SDIO_MAX_BLOCKS 256
+// Number of blocks in the circular DMA descriptor ring.
+// Transfers of any length stream through the ring, which is refilled as blocks complete.
+// During a read, the DMA IRQ must be serviced at least once every SDIO_RING_BLOCKS - 1 blocks.
+// Must be a power of 2.
+#ifndef SDIO_RING_BLOCKS
+#define SDIO_RING_BLOCKS 8
+#endif
+
+// Number of bounce buffers used to stream multiple block writes from unaligned buffers
+#ifndef SDIO_TX_BOUNCE_BLOCKS
+#define SDIO_TX_BOUNCE_BLOCKS 4
+#endif
+
+// Number of blocks at the end of a read whose checks are left for the next
+// operation under the SD_CRC_DEFERRED policy (without the worker on core 1).
+// They are copied, since the caller may reuse its buffers meanwhile.
+#ifndef SDIO_RX_DEFERRED_BLOCKS
+#define SDIO_RX_DEFERRED_BLOCKS 2
+#endif
+
+// Kernel for the 4-bit CRC16 of data blocks. They all compute the same checksum;
+// the fastest depends on the target. See sdio_crc16_4bit_checksum_*.
+#define SDIO_CRC16_SHIFT64 0  // One word per step, with 64-bit shifts
+#define SDIO_CRC16_TABLE 1    // Byte lookup tables (8 KB of RAM)
+#define SDIO_CRC16_SPLIT32 2  // 32-bit halves, for Cortex-M33/M0+ and Hazard3
+#define SDIO_CRC16_PAIR 3     // 32-bit halves, two words per step
+#ifndef SDIO_CRC16_KERNEL
+#define SDIO_CRC16_KERNEL SDIO_CRC16_SHIFT64
+#endif
+
+// Length of the queue of checksum jobs for the worker on core 1.
+// Jobs that don't fit are computed by the caller.
+// It is also the number of received blocks that can be with the worker at once.
+// Must be a power of 2, at least SDIO_RING_BLOCKS.
+#ifndef SDIO_CRC_QUEUE_LEN
+#define SDIO_CRC_QUEUE_LEN 16
+#endif
+
+// A block checksum, computed by the worker on core 1 or by the caller
+typedef struct sdio_crc_job_t {
+    const uint8_t *data;
+    uint32_t num_words;
+    uint64_t expected;      // Checksum received with the block (reception)
+    uint32_t blockidx;      // Block of the transfer (reception)
+    volatile uint64_t crc;  // Valid once done is set
+    volatile bool done;
+} sdio_crc_job_t;
 
-typedef enum sdio_transfer_state_t { SDIO_IDLE, SDIO_RX, SDIO_TX, SDIO_TX_WAIT_IDLE} sdio_transfer_state_t;
+// DMA control block, as written to the alias 0 registers of the data channel
+typedef struct sdio_dma_cb_t {
+    const volatile void *read_addr;
+    volatile void *write_addr;
+    uint32_t transfer_count;
+    volatile uint32_t ctrl; // Zero stops the chain
+} sdio_dma_cb_t;
+
+// Position in a list of sd_iovec_t segments.
+// The list is only read when moving on to the next segment.
+typedef struct sdio_iov_iter_t {
+    uint8_t *buf;               // Next block
+    uint32_t blocks_left;       // Blocks left in the current segment
+    const sd_iovec_t *next_seg;
+    uint32_t segs_left;
+} sdio_iov_iter_t;
+
+typedef enum sdio_transfer_state_t { SDIO_IDLE, SDIO_RX, SDIO_TX } sdio_transfer_state_t;
 
 typedef struct sd_sdio_if_state_t {
     bool resources_claimed;
@@ -47,6 +110,7 @@ typedef struct sd_sdio_if_state_t {
     
     int SDIO_DMA_CH;
     int SDIO_DMA_CHB;
+    int SDIO_DMA_CHC;
     int SDIO_CMD_SM;
     int SDIO_DATA_SM;
 
@@ -55,35 +119,77 @@ typedef struct sd_sdio_if_state_t {
     pio_sm_config pio_cfg_data_rx;
     uint32_t pio_data_tx_offset;
     pio_sm_config pio_cfg_data_tx;
+    const pio_program_t *pio_data_program; // Data program currently loaded
 
     sdio_transfer_state_t transfer_state;
     uint32_t transfer_start_time;
-    uint32_t *data_buf;
     uint32_t blocks_done; // Number of blocks transferred so far
     uint32_t total_blocks; // Total number of blocks to transfer
     uint32_t blocks_checksumed; // Number of blocks that have had CRC calculated
+    uint32_t blocks_queued; // Number of blocks whose CRC has been started (placed, for writes)
     uint32_t checksum_errors; // Number of checksum errors detected
 
+    // The first checksum error of a read is found in the IRQ handler or with
+    // interrupts disabled, so it is kept here and reported afterwards
+    bool rx_error_pending;
+    bool rx_error_late;
+    uint32_t rx_error_block;
+    const uint8_t *rx_error_data;
+    uint64_t rx_error_checksum;
+    uint64_t rx_error_expected;
+
     // Variables for block writes
-    uint64_t next_wr_block_checksum;
-    uint32_t end_token_buf[3]; // CRC and end token for write block
     sdio_status_t wr_status;
-    uint32_t card_response;
 
     // Variables for extended block writes
     bool ongoing_wr_mlt_blk;
     uint32_t wr_mlt_blk_cnt_sector;
+    bool wr_blk_cnt_set;  // Write was declared with CMD23, so it ends by itself
+    bool card_busy;       // Card may be holding D0 low while it programs
+
+    // Variables for extended block reads (read streams)
+    bool ongoing_rd_mlt_blk;
+    uint32_t rd_mlt_blk_cnt_sector;
     
-    // Variables for block reads
-    // This is used to perform DMA into data buffers and checksum buffers separately.
-    struct {
-        void * write_addr;
-        uint32_t transfer_count;
-    } dma_blocks[SDIO_MAX_BLOCKS * 2];
+    // Buffers of the transfer in progress
+    sdio_iov_iter_t fill_iter;   // Next block to put in the ring
+    sdio_iov_iter_t verify_iter; // Next block to checksum (block reads)
+    size_t block_size;
+    bool crc_offload; // Checksums of this transfer go to the worker on core 1
+    bool rx_checks_deferred; // Checksums of the last read are still to be verified (SD_CRC_DEFERRED)
+    bool rx_byte_lanes;
+    bool rx_stream;
+
+    // This is used to perform DMA into (or from) data buffers and checksum buffers separately.
+    // Block i of a transfer uses slot (ring_base + i) % SDIO_RING_BLOCKS of the ring.
+    uint32_t ring_base;
+    union {
+        // Block reads: data, checksum and kill for each slot, then loop
+        sdio_dma_cb_t rx_ring[SDIO_RING_BLOCKS * 3 + 1];
+        // Block writes: block header, data, checksum and kill for each slot, then loop
+        sdio_dma_cb_t tx_ring[SDIO_RING_BLOCKS * 4 + 1];
+    };
+    uint32_t dma_ctrl;          // Control word of armed header (writes) or data (reads) control blocks
+    const void *dma_ring_start; // Source for the loop control block
+    uint32_t dma_zero;          // Source for the kill control blocks
+    uint32_t tx_block_header;
+    sdio_dma_cb_t rx_brake;     // Pauses the bus clock at the end of a read stream
+    uint32_t pio_sm_mask;       // Command and data state machines
     struct {
         uint32_t top;
         uint32_t bottom;
-    } received_checksums[SDIO_MAX_BLOCKS];
+    } block_checksums[SDIO_RING_BLOCKS];
+    sdio_crc_job_t crc_jobs[SDIO_RING_BLOCKS]; // Block writes: block i uses crc_jobs[i % SDIO_RING_BLOCKS]
+    // Block reads: checks handed to the worker (or deferred), in order.
+    // Job i is rx_jobs[i % SDIO_CRC_QUEUE_LEN]. They are separate from the ring,
+    // so that a slot can be refilled as soon as its block has landed.
+    sdio_crc_job_t rx_jobs[SDIO_CRC_QUEUE_LEN];
+    uint32_t rx_jobs_queued;
+    uint32_t rx_jobs_collected;
+    // Write response for each block. Written by the DMA as a ring, so it must be aligned to its size.
+    uint32_t card_responses[SDIO_RING_BLOCKS] __attribute__((aligned(SDIO_RING_BLOCKS * 4)));
+    uint32_t tx_bounce_bufs[SDIO_TX_BOUNCE_BLOCKS][SDIO_WORDS_PER_BLOCK]; // For unaligned writes
+    uint32_t rx_deferred_bufs[SDIO_RX_DEFERRED_BLOCKS][SDIO_WORDS_PER_BLOCK]; // Copies of deferred blocks
 } sd_sdio_if_state_t;
 
 // Execute a command that has 48-bit reply (response types R1, R6, R7)
@@ -99,22 +205,63 @@ sdio_status_t rp2040_sdio_command_R3(sd_card_t *sd_card_p, uint8_t command, uint
 
 // Start transferring data from SD card to memory buffer
 sdio_status_t rp2040_sdio_rx_start(sd_card_t *sd_card_p, uint8_t *buffer, uint32_t num_blocks, size_t block_size);
+// Same, but scattering the blocks over the buffers in iov.
+// If any buffer is unaligned, the DMA moves single bytes.
+// If iovcnt > 1, iov must remain valid until the transfer has finished.
+sdio_status_t rp2040_sdio_rx_start_v(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt, size_t block_size);
+
+// Start a read stream. This is like rp2040_sdio_rx_start_v with 512 byte blocks, but
+// once the blocks have been received, the bus clock is paused at the next block boundary
+// with the card still in the middle of the multiple block read.
+sdio_status_t rp2040_sdio_rx_stream_start(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt);
+// Continue a paused read stream into the buffers in iov, without a new command.
+// Completion is checked with rp2040_sdio_rx_poll, as usual.
+// Returns false if the stream can't be continued into these buffers; it must be ended.
+bool rp2040_sdio_rx_stream_more(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt);
+// Restart the bus clock, so that the stream can be stopped with CMD12
+void rp2040_sdio_rx_stream_end(sd_card_t *sd_card_p);
 
 // Check if reception is complete
 // Returns SDIO_BUSY while transferring, SDIO_OK when done and error on failure.
+// The DMA IRQ handler verifies the blocks as they are received and signals an event
+// (__sev) when the transfer is complete, so the caller can sleep (__wfe) between calls.
 sdio_status_t rp2040_sdio_rx_poll(sd_card_t *sd_card_p, size_t block_size_words);
 
 // Start transferring data from memory to SD card
 sdio_status_t rp2040_sdio_tx_start(sd_card_t *sd_card_p, const uint8_t *buffer, uint32_t num_blocks);
+// Same, but gathering the blocks from the buffers in iov.
+// Blocks in unaligned buffers are copied through STATE.tx_bounce_bufs.
+// If iovcnt > 1, iov must remain valid until the transfer has finished.
+sdio_status_t rp2040_sdio_tx_start_v(sd_card_t *sd_card_p, const sd_iovec_t *iov, uint32_t iovcnt);
 
 // Check if transmission is complete
 sdio_status_t rp2040_sdio_tx_poll(sd_card_t *sd_card_p, uint32_t *bytes_complete /* = nullptr */);
 
+// 4-bit CRC16 of a block of num_words words, with the kernel selected by SDIO_CRC16_KERNEL
+uint64_t sdio_crc16_4bit_checksum(uint32_t *data, uint32_t num_words);
+// The individual kernels, for benchmarking
+uint64_t sdio_crc16_4bit_checksum_shift64(uint32_t *data, uint32_t num_words);
+uint64_t sdio_crc16_4bit_checksum_table(uint32_t *data, uint32_t num_words);
+uint64_t sdio_crc16_4bit_checksum_split32(uint32_t *data, uint32_t num_words);
+uint64_t sdio_crc16_4bit_checksum_pair(uint32_t *data, uint32_t num_words);
+
 // (Re)initialize the SDIO interface
 bool rp2040_sdio_init(sd_card_t *sd_card_p, float clk_div);
+// Change the bus clock between transfers
+void rp2040_sdio_set_clk_div(sd_card_t *sd_card_p, float clk_div);
 
 void __not_in_flash_func(sdio_irq_handler)(sd_card_t *sd_card_p);
 
+// Launch the checksum worker on core 1, and enable it.
+// Write checksums are then computed ahead of the DMA, and received blocks are verified
+// as they land, on core 1. Core 1 must not be used for anything else,
+// and the SDIO cards must only be accessed from core 0.
+void sdio_crc_worker_start(void);
+// Switch between the worker and computing the checksums on core 0.
+// This takes effect at the start of the next transfer.
+void sdio_crc_worker_enable(bool enable);
+bool sdio_crc_worker_enabled(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -34,6 +34,9 @@
 
 #define STATE sd_card_p->sdio_if_p->state
 
+// Card status bit: the previous command was not legal
+#define SDIO_STATUS_ILLEGAL_COMMAND (1UL << 22)
+
 static char const *errstr(sdio_status_t error) {
     switch (error) {
         case SDIO_OK:
@@ -90,10 +93,172 @@ static float calculate_clk_div(uint baud) {
     return div;
 }
 
+// Wait for a reception to complete.
+// The DMA IRQ handler verifies the blocks as they land and signals an event when
+// the transfer is done, so the core can sleep. It also wakes up every millisecond
+// so that rp2040_sdio_rx_poll can check for a timeout.
+static sdio_status_t sd_sdio_rx_wait(sd_card_t *sd_card_p, size_t block_size_words)
+{
+    sdio_status_t status;
+    while ((status = rp2040_sdio_rx_poll(sd_card_p, block_size_words)) == SDIO_BUSY)
+        best_effort_wfe_or_timeout(make_timeout_time_ms(1));
+    return status;
+}
+
+// Report the outcome of a data transfer of n blocks for the adaptive bus clock
+static void sd_sdio_clk_feedback(sd_card_t *sd_card_p, uint32_t n)
+{
+    uint32_t crc_errors;
+    switch (STATE.error)
+    {
+    case SDIO_OK:
+        crc_errors = 0;
+        break;
+    case SDIO_ERR_DATA_CRC:
+        crc_errors = STATE.checksum_errors ? STATE.checksum_errors : 1;
+        break;
+    case SDIO_ERR_WRITE_CRC:
+        crc_errors = 1;
+        break;
+    default:
+        return;
+    }
+    if (sd_clk_feedback(sd_card_p, n, crc_errors))
+    {
+        sd_card_p->state.clk.actual_hz = sd_card_p->state.clk.clk_hz;
+        rp2040_sdio_set_clk_div(sd_card_p, calculate_clk_div(sd_card_p->state.clk.clk_hz));
+    }
+}
+
+// Clock training probe: read block 0
+static bool sd_sdio_clk_probe(sd_card_t *sd_card_p)
+{
+    return sd_sdio_readSector(sd_card_p, 0, (uint8_t *)STATE.dma_buf);
+}
+
+/* Bus speed negotiation
+
+The card starts in Default Speed mode, which is good for up to 25 MHz.
+If the requested clock is faster and sdio_if_p->use_high_speed is set,
+High Speed mode (up to 50 MHz) is selected with CMD6 SWITCH_FUNC, if the
+card supports it. Otherwise, the clock is limited to 25 MHz.
+Without use_high_speed, the card stays in Default Speed mode and runs at
+the requested clock, as it always has.
+In High Speed mode, the card changes its outputs shortly after the rising
+clock edge (with an output hold time of 2.5 ns), while the PIO programs
+sample them right after it, so High Speed mode is opt-in.
+The clock is also limited by the PIO program, which takes CLKDIV system
+clock cycles per bus clock cycle.
+*/
+#define SD_DEFAULT_SPEED_MAX_HZ (25 * 1000 * 1000)
+#define SD_HIGH_SPEED_MAX_HZ (50 * 1000 * 1000)
+
+// CMD6 arguments: mode (check or switch) in bit 31, then one nibble per
+// function group, with 0xF leaving the group unchanged. Group 1 is access mode.
+#define SD_SWITCH_CHECK_HIGH_SPEED 0x00FFFFF1
+#define SD_SWITCH_SET_HIGH_SPEED 0x80FFFFF1
+
+bool sd_sdio_cardCMD6(sd_card_t *sd_card_p, uint32_t arg, uint8_t *status)
+{
+    uint32_t reply;
+    if (!checkReturnOk(rp2040_sdio_rx_start(sd_card_p, status, 1, 64)) || // Prepare for reception
+        !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD6_SWITCH_FUNC, arg, &reply))) // SWITCH_FUNC
+    {
+        EMSG_PRINTF("CMD6 failed\n");
+        return false;
+    }
+    // Read 512 bit switch function status on DAT bus
+    STATE.error = sd_sdio_rx_wait(sd_card_p, 64 / 4);
+
+    if (STATE.error != SDIO_OK)
+    {
+        EMSG_PRINTF("CMD6 failed: %s (%d)\n", errstr(STATE.error), (int)STATE.error);
+    }
+    return STATE.error == SDIO_OK;
+}
+
+// Read the SD Configuration Register (ACMD51) and note whether the card supports CMD23
+static bool sd_sdio_readSCR(sd_card_t *sd_card_p)
+{
+    uint32_t scr[2];
+    uint32_t reply;
+    sd_card_p->state.cmd23_supported = false;
+    // ACMD23 is mandatory for SD memory cards, but try it before relying on it
+    sd_card_p->state.pre_erase_supported = true;
+    if (!checkReturnOk(rp2040_sdio_rx_start(sd_card_p, (uint8_t *)scr, 1, sizeof scr)) || // Prepare for reception
+        !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD55_APP_CMD, STATE.rca, &reply)) || // APP_CMD
+        !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, ACMD51_SEND_SCR, 0, &reply))) // SEND_SCR
+    {
+        EMSG_PRINTF("ACMD51 failed\n");
+        return false;
+    }
+    STATE.error = sd_sdio_rx_wait(sd_card_p, sizeof scr / 4);
+    if (STATE.error != SDIO_OK)
+    {
+        EMSG_PRINTF("ACMD51 failed: %s (%d)\n", errstr(STATE.error), (int)STATE.error);
+        return false;
+    }
+    memcpy(sd_card_p->state.SCR, scr, sizeof scr);
+    sd_card_p->state.cmd23_supported = ext_bits(sizeof scr, sd_card_p->state.SCR, 33, 33);
+    return true;
+}
+
+// Select the fastest speed mode supported by both the card and the PIO program,
+// for the clock in sdio_if_p->baud_rate. Must be called in "tran" state.
+static void sd_sdio_negotiate_speed(sd_card_t *sd_card_p)
+{
+    sd_bus_profile_t *profile_p = &sd_card_p->state.bus_profile;
+    uint32_t clk_hz = sd_card_p->sdio_if_p->baud_rate;
+    uint32_t pio_max_hz = clock_get_hz(clk_sys) / CLKDIV;
+    if (clk_hz > pio_max_hz)
+        clk_hz = pio_max_hz;
+
+    profile_p->speed = SD_BUS_SPEED_DEFAULT;
+    profile_p->max_clk_hz = SD_DEFAULT_SPEED_MAX_HZ;
+    if (!sd_card_p->sdio_if_p->use_high_speed)
+    {
+        // Default Speed mode, at the requested clock
+        if (clk_hz > profile_p->max_clk_hz)
+            profile_p->max_clk_hz = clk_hz;
+        profile_p->clk_hz = clk_hz;
+        return;
+    }
+
+    // Card command class 10 (switch) is CCC bit 10, at CSD bit 94
+    if (clk_hz > SD_DEFAULT_SPEED_MAX_HZ && ext_bits16(sd_card_p->state.CSD, 94, 94))
+    {
+        uint8_t status[64];
+        // Switch function status:
+        //   415:400 Function group 1 support bits; bit 401 is High Speed
+        //   379:376 Function group 1 selection; 0xF if the function can't be selected
+        if (sd_sdio_cardCMD6(sd_card_p, SD_SWITCH_CHECK_HIGH_SPEED, status) &&
+            ext_bits(64, status, 401, 401) && ext_bits(64, status, 379, 376) == 1 &&
+            sd_sdio_cardCMD6(sd_card_p, SD_SWITCH_SET_HIGH_SPEED, status) &&
+            ext_bits(64, status, 379, 376) == 1)
+        {
+            profile_p->speed = SD_BUS_SPEED_HIGH;
+            profile_p->max_clk_hz = SD_HIGH_SPEED_MAX_HZ;
+        }
+        else
+        {
+            DBG_PRINTF("%s: card does not support High Speed mode\n", __func__);
+        }
+    }
+    if (clk_hz > profile_p->max_clk_hz)
+        clk_hz = profile_p->max_clk_hz;
+    profile_p->clk_hz = clk_hz;
+}
+
 bool sd_sdio_begin(sd_card_t *sd_card_p)
 {
     uint32_t reply;
     sdio_status_t status;
+
+    // GO_IDLE_STATE ends any multiple block transfer
+    STATE.ongoing_wr_mlt_blk = false;
+    STATE.ongoing_rd_mlt_blk = false;
+    STATE.card_busy = false;
+    sd_clk_init(sd_card_p, 0);
     
     // Initialize at 400 kHz clock speed
     if (!rp2040_sdio_init(sd_card_p, calculate_clk_div(400 * 1000)))
@@ -204,12 +369,20 @@ bool sd_sdio_begin(sd_card_t *sd_card_p)
         EMSG_PRINTF("%s,%d SDIO failed to set BLOCKLEN\n", __func__, __LINE__);
         return false;
     }
+    // Not fatal: without the SCR, multiple block transfers are open-ended
+    sd_sdio_readSCR(sd_card_p);
+
     // Increase to high clock rate
     if (!sd_card_p->sdio_if_p->baud_rate)
         sd_card_p->sdio_if_p->baud_rate = clock_get_hz(clk_sys) / 12; // Default
-    if (!rp2040_sdio_init(sd_card_p, calculate_clk_div(sd_card_p->sdio_if_p->baud_rate)))
+    sd_sdio_negotiate_speed(sd_card_p);
+    sd_clk_init(sd_card_p, sd_card_p->state.bus_profile.clk_hz);
+    if (!rp2040_sdio_init(sd_card_p, calculate_clk_div(sd_card_p->state.clk.clk_hz)))
         return false; 
 
+    // Find the highest clock this board can run reliably
+    sd_clk_train(sd_card_p, sd_sdio_clk_probe);
+
     return true;
 }
 
@@ -231,7 +404,30 @@ uint32_t sd_sdio_errorLine(sd_card_t *sd_card_p) // const
 bool sd_sdio_isBusy(sd_card_t *sd_card_p) 
 {
     // return (sio_hw->gpio_in & (1 << SDIO_D0)) == 0;
-    return (sio_hw->gpio_in & (1 << sd_card_p->sdio_if_p->D0_gpio)) == 0;
+    if (STATE.card_busy && (sio_hw->gpio_in & (1 << sd_card_p->sdio_if_p->D0_gpio)))
+        STATE.card_busy = false;
+    return STATE.card_busy;
+}
+
+/* Card busy tracking
+After a write block, the data state machine hands over the card's response
+as soon as it has been received, instead of after the card releases D0.
+The card then programs the flash in the background,
+and the wait is put off until the next transfer needs the data lines. */
+static bool sd_sdio_waitReady(sd_card_t *sd_card_p, uint32_t timeout)
+{
+    // An application's sd_timeouts might not set sd_timeouts.sd_sdio_busy
+    if (!timeout) timeout = SD_SDIO_BUSY_DEFAULT_MS;
+    uint32_t start = millis();
+    while (sd_sdio_isBusy(sd_card_p))
+    {
+        if (millis() - start >= timeout)
+        {
+            EMSG_PRINTF("%s: card busy timeout\n", __func__);
+            return false;
+        }
+    }
+    return true;
 }
 
 bool sd_sdio_readOCR(sd_card_t *sd_card_p, uint32_t* ocr)
@@ -252,14 +448,25 @@ uint32_t sd_sdio_status(sd_card_t *sd_card_p)
 
 bool sd_sdio_stopTransmission(sd_card_t *sd_card_p, bool blocking)
 {
+    if (STATE.ongoing_rd_mlt_blk)
+        // The clock is paused in a read stream
+        rp2040_sdio_rx_stream_end(sd_card_p);
 
+    bool was_writing = STATE.ongoing_wr_mlt_blk;
     STATE.ongoing_wr_mlt_blk = false;
+    STATE.ongoing_rd_mlt_blk = false;
+
+    // Let the last block of a write finish programming first
+    if (was_writing && !sd_sdio_waitReady(sd_card_p, sd_timeouts.sd_sdio_busy))
+        return false;
 
     uint32_t reply;
     if (!checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD12_STOP_TRANSMISSION, 0, &reply)))
     {
         return false;
     }
+    // R1b: the card signals busy on D0
+    STATE.card_busy = true;
 
     if (!blocking)
     {
@@ -267,17 +474,7 @@ bool sd_sdio_stopTransmission(sd_card_t *sd_card_p, bool blocking)
     }
     else
     {
-        uint32_t start = millis();
-        while (millis() - start < 200 && sd_sdio_isBusy(sd_card_p));
-        if (sd_sdio_isBusy(sd_card_p))
-        {
-            EMSG_PRINTF("sd_sdio_stopTransmission() timeout\n");
-            return false;
-        }
-        else
-        {
-            return true;
-        }
+        return sd_sdio_waitReady(sd_card_p, sd_timeouts.sd_sdio_stopTransmission);
     }
 }
 
@@ -294,7 +491,7 @@ uint8_t sd_sdio_type(sd_card_t *sd_card_p) // const
 
 bool sd_sdio_writeSector(sd_card_t *sd_card_p, uint32_t sector, const uint8_t* src)
 {
-    if (STATE.ongoing_wr_mlt_blk)
+    if (STATE.ongoing_wr_mlt_blk || STATE.ongoing_rd_mlt_blk)
         // Stop any ongoing write transmission
         if (!sd_sdio_stopTransmission(sd_card_p, true)) return false;
 
@@ -303,6 +500,7 @@ bool sd_sdio_writeSector(sd_card_t *sd_card_p, uint32_t sector, const uint8_t* s
         memcpy(STATE.dma_buf, src, sizeof(STATE.dma_buf));
         src = (uint8_t*)STATE.dma_buf;
     }
+    if (!sd_sdio_waitReady(sd_card_p, sd_timeouts.sd_sdio_busy)) return false;
 
     uint32_t reply;
     if (/* !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, 16, 512, &reply)) || // SET_BLOCKLEN */
@@ -316,6 +514,8 @@ bool sd_sdio_writeSector(sd_card_t *sd_card_p, uint32_t sector, const uint8_t* s
         uint32_t bytes_done;
         STATE.error = rp2040_sdio_tx_poll(sd_card_p, &bytes_done);
     } while (STATE.error == SDIO_BUSY);
+    STATE.card_busy = true;
+    sd_sdio_clk_feedback(sd_card_p, 1);
 
     if (STATE.error != SDIO_OK)
     {
@@ -326,42 +526,62 @@ bool sd_sdio_writeSector(sd_card_t *sd_card_p, uint32_t sector, const uint8_t* s
     return STATE.error == SDIO_OK;
 }
 
-bool sd_sdio_writeSectors(sd_card_t *sd_card_p, uint32_t sector, const uint8_t *src, size_t n) {
-    if (((uint32_t)src & 3) != 0) {
-        // Unaligned write, execute sector-by-sector
-        for (size_t i = 0; i < n; i++) {
-            if (!sd_sdio_writeSector(sd_card_p, sector + i, src + 512 * i)) {
-                return false;
-            }
-        }
-        return true;
-    }
+// Start a CMD25 transfer, or continue an ongoing one.
+static bool sd_sdio_writeSectorsStart(sd_card_t *sd_card_p, uint32_t sector, const sd_iovec_t *iov,
+                                      uint32_t iovcnt) {
     if (STATE.ongoing_wr_mlt_blk && sector == STATE.wr_mlt_blk_cnt_sector) {
         /* Continue a multiblock write */
-        if (!checkReturnOk(rp2040_sdio_tx_start(sd_card_p, src, n)))  // Start transmission
+        // The state machine was restarted, so it can't wait for the previous block itself
+        if (!sd_sdio_waitReady(sd_card_p, sd_timeouts.sd_sdio_busy) ||
+            !checkReturnOk(rp2040_sdio_tx_start_v(sd_card_p, iov, iovcnt)))  // Start transmission
             return false;
     } else {
         // Stop any previous transmission
-        if (STATE.ongoing_wr_mlt_blk) {
+        if (STATE.ongoing_wr_mlt_blk || STATE.ongoing_rd_mlt_blk) {
             if (!sd_sdio_stopTransmission(sd_card_p, true)) return false;
         }
+        if (!sd_sdio_waitReady(sd_card_p, sd_timeouts.sd_sdio_busy)) return false;
         uint32_t reply;
+        // Let the card erase the blocks ahead of the write
+        uint32_t pre_erase = sd_pre_erase_count(sd_card_p, sd_iov_blocks(iov, iovcnt));
+        if (pre_erase &&
+            checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD55_APP_CMD, STATE.rca, &reply)) &&
+            !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, ACMD23_SET_WR_BLK_ERASE_COUNT, pre_erase, &reply))) {
+            // It's only a hint. Stop sending it only if the card doesn't know the command:
+            // it doesn't respond, and flags it in the status of the next command.
+            if (STATE.error == SDIO_ERR_RESPONSE_TIMEOUT &&
+                (sd_sdio_status(sd_card_p) & SDIO_STATUS_ILLEGAL_COMMAND))
+                sd_card_p->state.pre_erase_supported = false;
+        }
+        STATE.wr_blk_cnt_set = false;
+        if (sd_use_cmd23(sd_card_p)) {
+            if (checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD23_SET_BLOCK_COUNT, sd_iov_blocks(iov, iovcnt), &reply))) {
+                STATE.wr_blk_cnt_set = true;
+            } else {
+                // Fall back to open-ended transfers
+                sd_card_p->state.cmd23_supported = false;
+            }
+        }
         if (!checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD25_WRITE_MULTIPLE_BLOCK, sector, &reply)) ||
-            !checkReturnOk(rp2040_sdio_tx_start(sd_card_p, src, n)))  // Start transmission
+            !checkReturnOk(rp2040_sdio_tx_start_v(sd_card_p, iov, iovcnt)))  // Start transmission
         {
             return false;
         }
     }
+    return true;
+}
 
-    do {
-        uint32_t bytes_done;
-        STATE.error = rp2040_sdio_tx_poll(sd_card_p, &bytes_done);
-    } while (STATE.error == SDIO_BUSY);
-
+// Finish a transfer started by sd_sdio_writeSectorsStart, once rp2040_sdio_tx_poll is no longer busy
+static bool sd_sdio_writeSectorsEnd(sd_card_t *sd_card_p, uint32_t sector, size_t n) {
+    sd_sdio_clk_feedback(sd_card_p, n);
+    STATE.card_busy = true;
     if (STATE.error != SDIO_OK) {
         EMSG_PRINTF("sd_sdio_writeSectors(,%lu,,%zu) failed: %s (%d)\n", sector, n, errstr(STATE.error), (int)STATE.error);
         sd_sdio_stopTransmission(sd_card_p, true);
         return false;
+    } else if (STATE.wr_blk_cnt_set) {
+        // The card has ended the transfer
+        return true;
     } else {
         STATE.wr_mlt_blk_cnt_sector = sector + n;
         STATE.ongoing_wr_mlt_blk = true;
@@ -378,9 +598,28 @@ bool sd_sdio_writeSectors(sd_card_t *sd_card_p, uint32_t sector, const uint8_t *
     */
 }
 
+// Write the segments to consecutive sectors in one transfer.
+static bool sd_sdio_writeSectorsV(sd_card_t *sd_card_p, uint32_t sector, const sd_iovec_t *iov, uint32_t iovcnt) {
+    if (!sd_sdio_writeSectorsStart(sd_card_p, sector, iov, iovcnt))
+        return false;
+
+    do {
+        uint32_t bytes_done;
+        STATE.error = rp2040_sdio_tx_poll(sd_card_p, &bytes_done);
+    } while (STATE.error == SDIO_BUSY);
+
+    return sd_sdio_writeSectorsEnd(sd_card_p, sector, sd_iov_blocks(iov, iovcnt));
+}
+
+bool sd_sdio_writeSectors(sd_card_t *sd_card_p, uint32_t sector, const uint8_t *src, size_t n) {
+    // Unaligned blocks are copied through bounce buffers by rp2040_sdio_tx_start_v
+    sd_iovec_t iov = {(uint8_t *)src, n};
+    return sd_sdio_writeSectorsV(sd_card_p, sector, &iov, 1);
+}
+
 bool sd_sdio_readSector(sd_card_t *sd_card_p, uint32_t sector, uint8_t* dst)
 {
-    if (STATE.ongoing_wr_mlt_blk)
+    if (STATE.ongoing_wr_mlt_blk || STATE.ongoing_rd_mlt_blk)
         // Stop any ongoing transmission
         if (!sd_sdio_stopTransmission(sd_card_p, true)) return false;
 
@@ -390,6 +629,8 @@ bool sd_sdio_readSector(sd_card_t *sd_card_p, uint32_t sector, uint8_t* dst)
         // Buffer is not aligned, need to memcpy() the data from a temporary buffer.
         dst = (uint8_t*)STATE.dma_buf;
     }
+    if (!sd_sdio_waitReady(sd_card_p, sd_timeouts.sd_sdio_busy)) return false;
+
     uint32_t reply;
     if (/* !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, 16, 512, &reply)) || // SET_BLOCKLEN */
         !checkReturnOk(rp2040_sdio_rx_start(sd_card_p, dst, 1, SDIO_BLOCK_SIZE)) || // Prepare for reception
@@ -398,9 +639,8 @@ bool sd_sdio_readSector(sd_card_t *sd_card_p, uint32_t sector, uint8_t* dst)
         return false;
     }
 
-    do {
-        STATE.error = rp2040_sdio_rx_poll(sd_card_p, SDIO_WORDS_PER_BLOCK);
-    } while (STATE.error == SDIO_BUSY);
+    STATE.error = sd_sdio_rx_wait(sd_card_p, SDIO_WORDS_PER_BLOCK);
+    sd_sdio_clk_feedback(sd_card_p, 1);
 
     if (STATE.error != SDIO_OK)
     {
@@ -416,52 +656,112 @@ bool sd_sdio_readSector(sd_card_t *sd_card_p, uint32_t sector, uint8_t* dst)
     return STATE.error == SDIO_OK;
 }
 
-bool sd_sdio_readSectors(sd_card_t *sd_card_p, uint32_t sector, uint8_t* dst, size_t n)
+// Start a CMD17 or CMD18 transfer, or continue an ongoing read stream.
+static bool sd_sdio_readSectorsStart(sd_card_t *sd_card_p, uint32_t sector, const sd_iovec_t *iov, uint32_t iovcnt)
 {
-    if (STATE.ongoing_wr_mlt_blk)
-        // Stop any ongoing transmission
+    if (STATE.ongoing_rd_mlt_blk && sector == STATE.rd_mlt_blk_cnt_sector)
+    {
+        /* Continue a multiblock read */
+        if (rp2040_sdio_rx_stream_more(sd_card_p, iov, iovcnt))
+            return true;
+    }
+    // Stop any previous transmission
+    if (STATE.ongoing_wr_mlt_blk || STATE.ongoing_rd_mlt_blk)
+    {
         if (!sd_sdio_stopTransmission(sd_card_p, true)) return false;
-        
-    if (((uint32_t)dst & 3) != 0 || sector + n >= sd_card_p->state.sectors)
+    }
+    if (!sd_sdio_waitReady(sd_card_p, sd_timeouts.sd_sdio_busy)) return false;
+
+    uint32_t reply;
+    if (1 == sd_iov_blocks(iov, iovcnt))
     {
-        // Unaligned read or end-of-drive read, execute sector-by-sector
-        for (size_t i = 0; i < n; i++)
+        if (!checkReturnOk(rp2040_sdio_rx_start_v(sd_card_p, iov, iovcnt, SDIO_BLOCK_SIZE)) || // Prepare for reception
+            !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD17_READ_SINGLE_BLOCK, sector, &reply))) // READ_SINGLE_BLOCK
         {
-            if (!sd_sdio_readSector(sd_card_p, sector + i, dst + 512 * i))
-            {
-                return false;
-            }
+            return false;
         }
-        return true;
     }
-
-    uint32_t reply;
-    if (/* !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, 16, 512, &reply)) || // SET_BLOCKLEN */
-        !checkReturnOk(rp2040_sdio_rx_start(sd_card_p, dst, n, SDIO_BLOCK_SIZE)) || // Prepare for reception
-        !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD18_READ_MULTIPLE_BLOCK, sector, &reply))) // READ_MULTIPLE_BLOCK
+    else
     {
-        return false;
+        if (!checkReturnOk(rp2040_sdio_rx_stream_start(sd_card_p, iov, iovcnt)) || // Prepare for reception
+            !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD18_READ_MULTIPLE_BLOCK, sector, &reply))) // READ_MULTIPLE_BLOCK
+        {
+            rp2040_sdio_rx_stream_end(sd_card_p);
+            return false;
+        }
+        STATE.ongoing_rd_mlt_blk = true;
     }
+    return true;
+}
 
-    do {
-        STATE.error = rp2040_sdio_rx_poll(sd_card_p, SDIO_WORDS_PER_BLOCK);
-    } while (STATE.error == SDIO_BUSY);
-
+// Finish a transfer started by sd_sdio_readSectorsStart, once rp2040_sdio_rx_poll is no longer busy
+static bool sd_sdio_readSectorsEnd(sd_card_t *sd_card_p, uint32_t sector, size_t n)
+{
+    sd_sdio_clk_feedback(sd_card_p, n);
     if (STATE.error != SDIO_OK)
     {
         EMSG_PRINTF("sd_sdio_readSectors(%ld,...,%d)  failed: %s (%d)\n", 
             sector, n, errstr(STATE.error), STATE.error);
-        sd_sdio_stopTransmission(sd_card_p, true);
+        if (STATE.ongoing_rd_mlt_blk)
+            sd_sdio_stopTransmission(sd_card_p, true);
         return false;
     }
-    else
+    else if (STATE.ongoing_rd_mlt_blk)
     {
-        return sd_sdio_stopTransmission(sd_card_p, true);
+        STATE.rd_mlt_blk_cnt_sector = sector + n;
     }
+    return true;
+    /* Optimization:
+    To optimize large contiguous reads, the card is left in the
+    multiple block read, with the bus clock paused at the next block,
+    until it is clear that the next operation is not a continuation.
+    The same rule as for writes applies: any transactions other than a
+    `sd_sdio_readSectors` continuation must stop it before proceding.
+    */
+}
+
+// Read consecutive sectors into the segments in one transfer.
+static bool sd_sdio_readSectorsV(sd_card_t *sd_card_p, uint32_t sector, const sd_iovec_t *iov, uint32_t iovcnt)
+{
+    if (!sd_sdio_readSectorsStart(sd_card_p, sector, iov, iovcnt))
+        return false;
+
+    STATE.error = sd_sdio_rx_wait(sd_card_p, SDIO_WORDS_PER_BLOCK);
+
+    return sd_sdio_readSectorsEnd(sd_card_p, sector, sd_iov_blocks(iov, iovcnt));
+}
+
+bool sd_sdio_readSectors(sd_card_t *sd_card_p, uint32_t sector, uint8_t* dst, size_t n)
+{
+    if (STATE.ongoing_wr_mlt_blk)
+        // Stop any ongoing transmission
+        if (!sd_sdio_stopTransmission(sd_card_p, true)) return false;
+        
+    // Unaligned reads are done with single byte DMA transfers by rp2040_sdio_rx_start_v
+    if (sector + n >= sd_card_p->state.sectors)
+    {
+        // End-of-drive read, execute sector-by-sector
+        for (size_t i = 0; i < n; i++)
+        {
+            if (!sd_sdio_readSector(sd_card_p, sector + i, dst + 512 * i))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    sd_iovec_t iov = {dst, n};
+    return sd_sdio_readSectorsV(sd_card_p, sector, &iov, 1);
 }
 
 // Get 512 bit (64 byte) SD Status
 bool rp2040_sdio_get_sd_status(sd_card_t *sd_card_p, uint8_t response[64]) {
+    if (STATE.ongoing_wr_mlt_blk || STATE.ongoing_rd_mlt_blk)
+        // Stop any ongoing transmission
+        if (!sd_sdio_stopTransmission(sd_card_p, true)) return false;
+    if (!sd_sdio_waitReady(sd_card_p, sd_timeouts.sd_sdio_busy)) return false;
+
     uint32_t reply;
     if (!checkReturnOk(rp2040_sdio_rx_start(sd_card_p, response, 1, 64)) || // Prepare for reception
         !checkReturnOk(rp2040_sdio_command_R1(sd_card_p, CMD55_APP_CMD, STATE.rca, &reply)) ||  // APP_CMD
@@ -471,9 +771,7 @@ bool rp2040_sdio_get_sd_status(sd_card_t *sd_card_p, uint8_t response[64]) {
         return false;
     }
     // Read 512 bit block on DAT bus (not CMD)
-    do {
-        STATE.error = rp2040_sdio_rx_poll(sd_card_p, 64 / 4);
-    } while (STATE.error == SDIO_BUSY);
+    STATE.error = sd_sdio_rx_wait(sd_card_p, 64 / 4);
 
     if (STATE.error != SDIO_OK)
     {
@@ -489,6 +787,10 @@ static bool sd_sdio_test_com(sd_card_t *sd_card_p) {
     if (!(sd_card_p->state.m_Status & STA_NOINIT)) {
         // SD card is currently initialized
 
+        // A paused read stream has no bus clock for the command
+        if (STATE.ongoing_rd_mlt_blk)
+            sd_sdio_stopTransmission(sd_card_p, true);
+
         // Get status
         uint32_t reply = 0;
         sdio_status_t status = rp2040_sdio_command_R1(sd_card_p, CMD13_SEND_STATUS, STATE.rca, &reply);
@@ -627,12 +929,120 @@ static block_dev_err_t sd_sdio_read_blocks(sd_card_t *sd_card_p, uint8_t *buffer
     else
         return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
 }
-static block_dev_err_t sd_sync(sd_card_t *sd_card_p) {
+/* Vectored transfers
+The segments go in a single CMD18 or CMD25.
+End-of-drive reads are done segment by segment. */
+static block_dev_err_t sd_sdio_write_blocks_v(sd_card_t *sd_card_p, const sd_iovec_t *iov,
+                                              uint32_t iovcnt, uint32_t ulSectorNumber) {
+    TRACE_PRINTF("%s(,,%lu,%lu)\n", __func__, iovcnt, ulSectorNumber);
+    if (!sd_iov_blocks(iov, iovcnt)) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+
     sd_lock(sd_card_p);
+    bool ok = sd_sdio_writeSectorsV(sd_card_p, ulSectorNumber, iov, iovcnt);
+    sd_unlock(sd_card_p);
+
+    if (ok)
+        return SD_BLOCK_DEVICE_ERROR_NONE;
+    else
+        return SD_BLOCK_DEVICE_ERROR_WRITE;
+}
+static block_dev_err_t sd_sdio_read_blocks_v(sd_card_t *sd_card_p, const sd_iovec_t *iov,
+                                             uint32_t iovcnt, uint32_t ulSectorNumber) {
+    if (!sd_iov_blocks(iov, iovcnt)) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    bool ok = true;
+
+    sd_lock(sd_card_p);
+
+    if (STATE.ongoing_wr_mlt_blk)
+        // Stop any ongoing transmission
+        ok = sd_sdio_stopTransmission(sd_card_p, true);
+
+    uint32_t n = sd_iov_blocks(iov, iovcnt);
+    if (ok && ulSectorNumber + n < sd_card_p->state.sectors) {
+        ok = sd_sdio_readSectorsV(sd_card_p, ulSectorNumber, iov, iovcnt);
+    } else {
+        for (uint32_t i = 0; ok && i < iovcnt; ++i) {
+            ok = sd_sdio_readSectors(sd_card_p, ulSectorNumber, iov[i].buffer, iov[i].count);
+            ulSectorNumber += iov[i].count;
+        }
+    }
+    sd_unlock(sd_card_p);
+
+    if (ok)
+        return SD_BLOCK_DEVICE_ERROR_NONE;
+    else
+        return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+}
+/* Asynchronous transfers
+End-of-drive reads take the synchronous, sector-by-sector
+path and complete before returning. */
+static block_dev_err_t sd_sdio_async_end(sd_card_t *sd_card_p, sd_async_req_t *req_p, bool ok) {
+    sd_unlock(sd_card_p);
     block_dev_err_t err = SD_BLOCK_DEVICE_ERROR_NONE;
+    if (!ok)
+        err = req_p->write ? SD_BLOCK_DEVICE_ERROR_WRITE : SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+    sd_async_complete(req_p, err);
+    return err;
+}
+static block_dev_err_t sd_sdio_write_blocks_async(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                                  const uint8_t *buffer, uint32_t ulSectorNumber,
+                                                  uint32_t blockCnt) {
+    sd_lock(sd_card_p);
+    sd_async_start(sd_card_p, req_p, true, ulSectorNumber, blockCnt);
+    req_p->wr_buf = buffer;
+
+    sd_iovec_t iov = {(uint8_t *)buffer, blockCnt};
+    if (!sd_sdio_writeSectorsStart(sd_card_p, ulSectorNumber, &iov, 1))
+        return sd_sdio_async_end(sd_card_p, req_p, false);
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+static block_dev_err_t sd_sdio_read_blocks_async(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                                 uint8_t *buffer, uint32_t ulSectorNumber,
+                                                 uint32_t ulSectorCount) {
+    sd_lock(sd_card_p);
+    sd_async_start(sd_card_p, req_p, false, ulSectorNumber, ulSectorCount);
+    req_p->rd_buf = buffer;
+
+    if (ulSectorNumber + ulSectorCount >= sd_card_p->state.sectors) {
+        bool ok = sd_sdio_readSectors(sd_card_p, ulSectorNumber, buffer, ulSectorCount);
+        return sd_sdio_async_end(sd_card_p, req_p, ok);
+    }
     if (STATE.ongoing_wr_mlt_blk)
+        // Stop any ongoing transmission
+        if (!sd_sdio_stopTransmission(sd_card_p, true))
+            return sd_sdio_async_end(sd_card_p, req_p, false);
+    sd_iovec_t iov = {buffer, ulSectorCount};
+    if (!sd_sdio_readSectorsStart(sd_card_p, ulSectorNumber, &iov, 1))
+        return sd_sdio_async_end(sd_card_p, req_p, false);
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+static bool sd_sdio_poll_async(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    bool ok;
+    if (req_p->write) {
+        uint32_t bytes_done;
+        STATE.error = rp2040_sdio_tx_poll(sd_card_p, &bytes_done);
+        req_p->blocks_done = bytes_done / SDIO_BLOCK_SIZE;
+        if (STATE.error == SDIO_BUSY) return true;
+        ok = sd_sdio_writeSectorsEnd(sd_card_p, req_p->sector, req_p->count);
+    } else {
+        STATE.error = rp2040_sdio_rx_poll(sd_card_p, SDIO_WORDS_PER_BLOCK);
+        req_p->blocks_done = STATE.blocks_done;
+        if (STATE.error == SDIO_BUSY) return true;
+        ok = sd_sdio_readSectorsEnd(sd_card_p, req_p->sector, req_p->count);
+    }
+    if (ok) req_p->blocks_done = req_p->count;
+    sd_sdio_async_end(sd_card_p, req_p, ok);
+    return false;
+}
+static block_dev_err_t sd_sync(sd_card_t *sd_card_p) {
+    sd_lock(sd_card_p);
+    block_dev_err_t err = SD_BLOCK_DEVICE_ERROR_NONE;
+    if (STATE.ongoing_wr_mlt_blk || STATE.ongoing_rd_mlt_blk)
         if (!sd_sdio_stopTransmission(sd_card_p, true))
             err = SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+    // Data isn't safe until the card has finished programming it
+    if (!sd_sdio_waitReady(sd_card_p, sd_timeouts.sd_sdio_busy))
+        err = SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     sd_unlock(sd_card_p);
     return err;
 }
@@ -658,6 +1068,11 @@ void sd_sdio_ctor(sd_card_t *sd_card_p) {
     sd_card_p->deinit = sd_sdio_deinit;
     sd_card_p->write_blocks = sd_sdio_write_blocks;
     sd_card_p->read_blocks = sd_sdio_read_blocks;
+    sd_card_p->write_blocks_v = sd_sdio_write_blocks_v;
+    sd_card_p->read_blocks_v = sd_sdio_read_blocks_v;
+    sd_card_p->write_blocks_async = sd_sdio_write_blocks_async;
+    sd_card_p->read_blocks_async = sd_sdio_read_blocks_async;
+    sd_card_p->poll_async = sd_sdio_poll_async;
     sd_card_p->sync = sd_sync;
     sd_card_p->get_num_sectors = sd_sdio_sectorCount;
     sd_card_p->sd_test_com = sd_sdio_test_com;
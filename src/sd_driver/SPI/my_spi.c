@@ -31,12 +31,14 @@ specific language governing permissions and limitations under the License.
 #include "util.h"
 //
 #include "my_spi.h"
+#include "pio_spi.h"
 
 #ifndef USE_DBG_PRINTF
 #pragma GCC diagnostic ignored "-Wunused-variable"
 #endif
 
 static bool chk_spi(spi_t *spi_p) {
+    if (spi_p->pio) return pio_spi_chk(spi_p);
     spi_inst_t *hw_spi = spi_p->hw_inst;
     bool ok = true;
     if (spi_get_const_hw(hw_spi)->sr & SPI_SSPSR_BSY_BITS) {
@@ -91,6 +93,22 @@ static bool chk_dma(uint chn) {
     return ok;
 }
 
+// Data register (SPI HW) or FIFOs (PIO) for the DMA
+static volatile void *tx_fifo(spi_t *spi_p) {
+    if (spi_p->pio) return pio_spi_tx_fifo(spi_p);
+    return &spi_get_hw(spi_p->hw_inst)->dr;
+}
+static volatile void *rx_fifo(spi_t *spi_p) {
+    if (spi_p->pio) return pio_spi_rx_fifo(spi_p);
+    return &spi_get_hw(spi_p->hw_inst)->dr;
+}
+// Still shifting out data after the DMA is done
+static bool is_busy(spi_t *spi_p) {
+    // The PIO has received every bit when the RX DMA is done
+    if (spi_p->pio) return false;
+    return spi_is_busy(spi_p->hw_inst);
+}
+
 static bool chk_dmas(spi_t *spi_p) {
     bool tx_ok = chk_dma(spi_p->tx_dma);
     if (!tx_ok) DBG_PRINTF("TX DMA error\n");
@@ -99,18 +117,34 @@ static bool chk_dmas(spi_t *spi_p) {
     return tx_ok && rx_ok;
 }
 
-/**
- * @brief Start a SPI transfer by configuring and starting the DMA channels.
- *
- * @param spi_p Pointer to the SPI object.
- * @param tx Pointer to the transmit buffer. If NULL, data will be filled with SPI_FILL_CHAR.
- * @param rx Pointer to the receive buffer. If NULL, data will be ignored.
- * @param length Length of the transfer.
- */
-void spi_transfer_start(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+/* DMA sniffer
+The DMA has a single sniff unit, which can compute the CRC16 (CCITT, as used
+for SD data blocks) of the data passing through one channel, at no cost to
+the CPU. It is shared by all SPIs: a transfer that asks for it gets it only
+if it is free, and otherwise the caller computes the CRC in software.
+Define SD_SPI_DMA_SNIFFER as 0 if the application uses the sniffer itself. */
+#ifndef SD_SPI_DMA_SNIFFER
+#define SD_SPI_DMA_SNIFFER 1
+#endif
+
+auto_init_mutex(sniffer_mutex);
+
+static void sniffer_release(spi_t *spi_p) {
+    if (!spi_p->sniffing) return;
+    dma_sniffer_disable();
+    spi_p->sniffing = false;
+    mutex_exit(&sniffer_mutex);
+}
+
+// Configure the DMA channels for a transfer, without starting them
+static void configure_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
     myASSERT(spi_p);
     myASSERT(tx || rx);
 
+    // The sniffer watches the channel that carries the data
+    channel_config_set_sniff_enable(&spi_p->tx_dma_cfg, spi_p->sniffing && tx);
+    channel_config_set_sniff_enable(&spi_p->rx_dma_cfg, spi_p->sniffing && !tx);
+
     // tx write increment is already false
     if (tx) {
         channel_config_set_read_increment(&spi_p->tx_dma_cfg, true);
@@ -129,20 +163,33 @@ void spi_transfer_start(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t len
     }
 
     dma_channel_configure(spi_p->tx_dma, &spi_p->tx_dma_cfg,
-                          &spi_get_hw(spi_p->hw_inst)->dr,  // write address
+                          tx_fifo(spi_p),                   // write address
                           tx,                               // read address
                           length,                           // element count (each element is of
                                                             // size transfer_data_size)
                           false);                           // start
     dma_channel_configure(spi_p->rx_dma, &spi_p->rx_dma_cfg,
                           rx,                               // write address
-                          &spi_get_hw(spi_p->hw_inst)->dr,  // read address
+                          rx_fifo(spi_p),                   // read address
                           length,                           // element count (each element is of
                                                             // size transfer_data_size)
                           false);                           // start
 
     myASSERT(chk_dmas(spi_p));
     myASSERT(chk_spi(spi_p));
+}
+
+/**
+ * @brief Start a SPI transfer by configuring and starting the DMA channels.
+ *
+ * @param spi_p Pointer to the SPI object.
+ * @param tx Pointer to the transmit buffer. If NULL, data will be filled with SPI_FILL_CHAR.
+ * @param rx Pointer to the receive buffer. If NULL, data will be ignored.
+ * @param length Length of the transfer.
+ */
+void spi_transfer_start(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+    sniffer_release(spi_p);  // In case a CRC was never collected
+    configure_transfer(spi_p, tx, rx, length);
 
     // Start the DMA channels:
     // start them exactly simultaneously to avoid races (in extreme cases
@@ -150,6 +197,44 @@ void spi_transfer_start(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t len
     dma_start_channel_mask((1u << spi_p->tx_dma) | (1u << spi_p->rx_dma));
 }
 
+/**
+ * @brief Start a SPI transfer, with the DMA sniffer computing the CRC16 of the data.
+ *
+ * @param spi_p Pointer to the SPI object.
+ * @param tx Pointer to the transmit buffer. If NULL, the CRC is computed on the received data.
+ * @param rx Pointer to the receive buffer.
+ * @param length Length of the transfer.
+ * @param seed Initial value of the CRC (0, or the CRC of preceding bytes of the block).
+ * @return true if the sniffer was free. Get the CRC with spi_get_crc16 when the transfer is
+ * complete. If false, the transfer is started without the sniffer.
+ */
+bool spi_transfer_start_crc16(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length,
+                              uint16_t seed) {
+    sniffer_release(spi_p);  // In case a CRC was never collected
+    spi_p->sniffing = SD_SPI_DMA_SNIFFER && mutex_try_enter(&sniffer_mutex, NULL);
+    configure_transfer(spi_p, tx, rx, length);
+    if (spi_p->sniffing) {
+        dma_sniffer_enable(tx ? spi_p->tx_dma : spi_p->rx_dma, DMA_SNIFF_CTRL_CALC_VALUE_CRC16,
+                           false);
+        dma_sniffer_set_data_accumulator(seed);
+    }
+    dma_start_channel_mask((1u << spi_p->tx_dma) | (1u << spi_p->rx_dma));
+    return spi_p->sniffing;
+}
+
+/**
+ * @brief Get the CRC16 computed by the DMA sniffer, and release the sniffer.
+ *
+ * @param spi_p Pointer to the SPI object.
+ * @return The CRC16 of the data of a completed transfer started by spi_transfer_start_crc16.
+ */
+uint16_t spi_get_crc16(spi_t *spi_p) {
+    myASSERT(spi_p->sniffing);
+    uint16_t crc = dma_sniffer_get_data_accumulator();
+    sniffer_release(spi_p);
+    return crc;
+}
+
 /**
  * Calculate the time in milliseconds to transfer the given number of blocks
  * over the SPI bus at the given baud rate.
@@ -162,7 +247,7 @@ uint32_t calculate_transfer_time_ms(spi_t *spi_p, uint32_t bytes) {
     uint32_t total_bits = bytes * 8;
 
     // Get the baud rate from the SPI interface
-    uint32_t baud_rate = spi_get_baudrate(spi_p->hw_inst);
+    uint32_t baud_rate = my_spi_get_baudrate(spi_p);
 
     // Calculate the time to transfer all bits in seconds
     float transfer_time_sec = (double)total_bits / baud_rate;
@@ -208,11 +293,11 @@ bool __not_in_flash_func(spi_transfer_wait_complete)(spi_t *spi_p, uint32_t time
     } else {
         // If the DMA channels are not busy, wait for the SPI peripheral to become idle
         start = millis();
-        while (spi_is_busy(spi_p->hw_inst) && millis() - start < timeout_ms)
+        while (is_busy(spi_p) && millis() - start < timeout_ms)
             tight_loop_contents();
 
         // Check if the SPI peripheral is still busy
-        timed_out = spi_is_busy(spi_p->hw_inst);
+        timed_out = is_busy(spi_p);
 
         // Print debug information if the SPI peripheral is still busy
         if (timed_out) {
@@ -230,14 +315,19 @@ bool __not_in_flash_func(spi_transfer_wait_complete)(spi_t *spi_p, uint32_t time
                    uint_binary_str(dma_hw->ch[spi_p->tx_dma].ctrl_trig));
         DBG_PRINTF("RX DMA CTRL_TRIG: 0b%s\n",
                    uint_binary_str(dma_hw->ch[spi_p->rx_dma].ctrl_trig));
-        DBG_PRINTF("SPI SSPCR0: 0b%s\n", uint_binary_str(spi_get_hw(spi_p->hw_inst)->cr0));
-        DBG_PRINTF("SPI SSPCR1: 0b%s\n", uint_binary_str(spi_get_hw(spi_p->hw_inst)->cr1));
-        DBG_PRINTF("SPI_SSPSR: 0b%s\n", uint_binary_str(spi_get_const_hw(spi_p->hw_inst)->sr));
-        DBG_PRINTF("SPI_SSPDMACR: 0b%s\n",
-                   uint_binary_str(spi_get_const_hw(spi_p->hw_inst)->dmacr));
+        if (spi_p->pio) {
+            pio_spi_dump(spi_p);
+        } else {
+            DBG_PRINTF("SPI SSPCR0: 0b%s\n", uint_binary_str(spi_get_hw(spi_p->hw_inst)->cr0));
+            DBG_PRINTF("SPI SSPCR1: 0b%s\n", uint_binary_str(spi_get_hw(spi_p->hw_inst)->cr1));
+            DBG_PRINTF("SPI_SSPSR: 0b%s\n", uint_binary_str(spi_get_const_hw(spi_p->hw_inst)->sr));
+            DBG_PRINTF("SPI_SSPDMACR: 0b%s\n",
+                       uint_binary_str(spi_get_const_hw(spi_p->hw_inst)->dmacr));
+        }
 
         dma_channel_abort(spi_p->rx_dma);
         dma_channel_abort(spi_p->tx_dma);
+        sniffer_release(spi_p);
     }
     // Return true if the transfer is complete and the SPI peripheral is in a good state
     return !(timed_out || !spi_ok);
@@ -261,6 +351,22 @@ bool __not_in_flash_func(spi_transfer)(spi_t *spi_p, const uint8_t *tx, uint8_t
     return spi_transfer_wait_complete(spi_p, timeout);
 }
 
+/**
+ * @brief Set the SPI clock frequency.
+ *
+ * @param spi_p Pointer to the SPI object.
+ * @param baudrate The requested frequency in Hertz.
+ * @return The actual frequency.
+ */
+uint my_spi_set_baudrate(spi_t *spi_p, uint baudrate) {
+    if (spi_p->pio) return pio_spi_set_baudrate(spi_p, baudrate);
+    return spi_set_baudrate(spi_p->hw_inst, baudrate);
+}
+uint my_spi_get_baudrate(spi_t *spi_p) {
+    if (spi_p->pio) return pio_spi_get_baudrate(spi_p);
+    return spi_get_baudrate(spi_p->hw_inst);
+}
+
 /**
  * @brief Initialize the SPI peripheral and DMA channels.
  *
@@ -276,34 +382,43 @@ bool my_spi_init(spi_t *spi_p) {
         spi_lock(spi_p);
 
         // Defaults:
-        if (!spi_p->hw_inst) spi_p->hw_inst = spi0;
+        if (!spi_p->hw_inst && !spi_p->pio) spi_p->hw_inst = spi0;
         if (!spi_p->baud_rate) spi_p->baud_rate = clock_get_hz(clk_sys) / 12;
 
         /* Configure component */
-        // Enable SPI at 100 kHz and connect to GPIOs
-        spi_init(spi_p->hw_inst, 100 * 1000);
-
-        myASSERT(spi_p->spi_mode < 4);
-        switch (spi_p->spi_mode) {
-            case 0:
-                spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
-                break;
-            case 1:
-                spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_0, SPI_CPHA_1, SPI_MSB_FIRST);
-                break;
-            case 2:
-                spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_1, SPI_CPHA_0, SPI_MSB_FIRST);
-                break;
-            case 3:
-                spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
-                break;
-            default:
-                spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
-                break;
+        if (spi_p->pio) {
+            // Start a state machine at 100 kHz on the GPIOs
+            if (!pio_spi_init(spi_p)) {
+                spi_unlock(spi_p);
+                mutex_exit(&my_spi_init_mutex);
+                return false;
+            }
+        } else {
+            // Enable SPI at 100 kHz and connect to GPIOs
+            spi_init(spi_p->hw_inst, 100 * 1000);
+
+            myASSERT(spi_p->spi_mode < 4);
+            switch (spi_p->spi_mode) {
+                case 0:
+                    spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+                    break;
+                case 1:
+                    spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_0, SPI_CPHA_1, SPI_MSB_FIRST);
+                    break;
+                case 2:
+                    spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_1, SPI_CPHA_0, SPI_MSB_FIRST);
+                    break;
+                case 3:
+                    spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+                    break;
+                default:
+                    spi_set_format(spi_p->hw_inst, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+                    break;
+            }
+            gpio_set_function(spi_p->miso_gpio, GPIO_FUNC_SPI);
+            gpio_set_function(spi_p->mosi_gpio, GPIO_FUNC_SPI);
+            gpio_set_function(spi_p->sck_gpio, GPIO_FUNC_SPI);
         }
-        gpio_set_function(spi_p->miso_gpio, GPIO_FUNC_SPI);
-        gpio_set_function(spi_p->mosi_gpio, GPIO_FUNC_SPI);
-        gpio_set_function(spi_p->sck_gpio, GPIO_FUNC_SPI);
         // ss_gpio is initialized in sd_spi_ctor()
 
         // Slew rate limiting levels for GPIO outputs.
@@ -349,14 +464,18 @@ bool my_spi_init(spi_t *spi_p) {
         // transmit FIFO paced by the SPI TX FIFO DREQ The default is for the
         // read address to increment every element (in this case 1 byte -
         // DMA_SIZE_8) and for the write address to remain unchanged.
-        channel_config_set_dreq(&spi_p->tx_dma_cfg, spi_get_dreq(spi_p->hw_inst, true));
+        channel_config_set_dreq(&spi_p->tx_dma_cfg,
+                                spi_p->pio ? pio_get_dreq(spi_p->pio, spi_p->pio_sm, true)
+                                           : spi_get_dreq(spi_p->hw_inst, true));
         channel_config_set_write_increment(&spi_p->tx_dma_cfg, false);
 
         // We set the inbound DMA to transfer from the SPI receive FIFO to a
         // memory buffer paced by the SPI RX FIFO DREQ We configure the read
         // address to remain unchanged for each element, but the write address
         // to increment (so data is written throughout the buffer)
-        channel_config_set_dreq(&spi_p->rx_dma_cfg, spi_get_dreq(spi_p->hw_inst, false));
+        channel_config_set_dreq(&spi_p->rx_dma_cfg,
+                                spi_p->pio ? pio_get_dreq(spi_p->pio, spi_p->pio_sm, false)
+                                           : spi_get_dreq(spi_p->hw_inst, false));
         channel_config_set_read_increment(&spi_p->rx_dma_cfg, false);
 
         LED_INIT();
@@ -26,8 +26,11 @@ specific language governing permissions and limitations under the License.
 #include "hardware/dma.h"
 #include "hardware/gpio.h"
 #include "hardware/irq.h"
+#include "hardware/pio.h"
 #include "hardware/spi.h"
+#include "hardware/sync.h"
 //
+#include "delays.h"
 #include "my_debug.h"
 #include "sd_timeouts.h"
 
@@ -37,9 +40,21 @@ extern "C" {
 
 #define SPI_FILL_CHAR (0xFF)
 
+/* Longest time, in milliseconds, that a user of a shared SPI keeps it for a
+long transfer while others are waiting for it. After that, it lets them
+have their turns and then resumes. */
+#ifndef SD_SPI_MAX_HOLD_MS
+#define SD_SPI_MAX_HOLD_MS 10
+#endif
+
 // "Class" representing SPIs
 typedef struct spi_t {
     spi_inst_t *hw_inst;    // SPI HW
+    /* To implement the SPI with a PIO state machine instead of the SPI HW,
+    set pio to pio0 or pio1 (or pio2 on RP2350) and leave hw_inst unset.
+    Then any GPIOs can be used, there can be as many SPIs as free state
+    machines, and the clock can go up to clk_sys / 4. See pio_spi.h. */
+    PIO pio;
     uint miso_gpio;  // SPI MISO GPIO number (not pin number)
     uint mosi_gpio;
     uint sck_gpio;
@@ -76,22 +91,73 @@ typedef struct spi_t {
     dma_channel_config tx_dma_cfg;
     dma_channel_config rx_dma_cfg;
     mutex_t mutex;    
+    volatile uint32_t next_ticket;  // Next place in the queue for the SPI
+    volatile uint32_t now_serving;  // Ticket of the current owner
+    uint32_t turn_start;            // When the current owner got the SPI (millis)
+    lock_owner_id_t owner;          // Caller that has the SPI (see lock_get_caller_owner_id)
     bool initialized;  
+    bool sniffing;  // Holds the DMA sniffer for the current transfer
+    uint pio_sm;
+    uint pio_clkdiv;
 } spi_t;
 
 void spi_transfer_start(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length);
+bool spi_transfer_start_crc16(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length,
+                              uint16_t seed);
+uint16_t spi_get_crc16(spi_t *spi_p);
 uint32_t calculate_transfer_time_ms(spi_t *spi_p, uint32_t bytes);
 bool spi_transfer_wait_complete(spi_t *spi_p, uint32_t timeout_ms);
 bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length);
 bool my_spi_init(spi_t *spi_p);
-
-static inline void spi_lock(spi_t *spi_p) {
+uint my_spi_set_baudrate(spi_t *spi_p, uint baudrate);
+uint my_spi_get_baudrate(spi_t *spi_p);
+
+/* Sharing an SPI
+Several SD cards can be on the same SPI, each with its own SS. They get the
+SPI in the order that they ask for it, like customers taking numbers at a
+counter: spi_take_ticket() joins the queue, and spi_try_turn() checks
+whether it is that ticket's turn yet. An asynchronous request polls this
+instead of blocking. spi_lock() does both, blocking, so one card can't
+starve another. spi_unlock() hands the SPI to the next ticket. */
+static inline uint32_t spi_take_ticket(spi_t *spi_p) {
     myASSERT(mutex_is_initialized(&spi_p->mutex));
     mutex_enter_blocking(&spi_p->mutex);
+    uint32_t ticket = spi_p->next_ticket++;
+    mutex_exit(&spi_p->mutex);
+    return ticket;
+}
+// Returns true, and gives the caller the SPI, when it is the ticket's turn
+static inline bool spi_try_turn(spi_t *spi_p, uint32_t ticket) {
+    if (spi_p->now_serving != ticket) return false;
+    __mem_fence_acquire();
+    spi_p->turn_start = millis();
+    spi_p->owner = lock_get_caller_owner_id();
+    return true;
 }
+static inline void spi_lock(spi_t *spi_p) {
+    uint32_t ticket = spi_take_ticket(spi_p);
+    while (!spi_try_turn(spi_p, ticket)) tight_loop_contents();
+}
+// Only the caller that has the SPI may hand it on
 static inline void spi_unlock(spi_t *spi_p) {
     myASSERT(mutex_is_initialized(&spi_p->mutex));
-    mutex_exit(&spi_p->mutex);
+    myASSERT(spi_p->now_serving != spi_p->next_ticket);
+    myASSERT(spi_p->owner == lock_get_caller_owner_id());
+    spi_p->owner = LOCK_INVALID_OWNER_ID;
+    __mem_fence_release();
+    spi_p->now_serving = spi_p->now_serving + 1;
+}
+// True if anyone is waiting for the SPI while the caller has it
+static inline bool spi_has_waiters(spi_t *spi_p) {
+    return spi_p->next_ticket - spi_p->now_serving > 1;
+}
+// True if the caller has had the SPI for long enough while others waited
+static inline bool spi_should_yield(spi_t *spi_p) {
+    return spi_has_waiters(spi_p) && millis() - spi_p->turn_start >= SD_SPI_MAX_HOLD_MS;
+}
+// True while a transfer started by spi_transfer_start is in progress
+static inline bool spi_transfer_is_busy(spi_t *spi_p) {
+    return dma_channel_is_busy(spi_p->rx_dma) || dma_channel_is_busy(spi_p->tx_dma);
 }
 
 /* 
@@ -0,0 +1,141 @@
+/* pio_spi.c
+Copyright 2021 Carl John Kugler III
+
+Licensed under the Apache License, Version 2.0 (the License); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an AS IS BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+//
+#include "hardware/clocks.h"
+#include "hardware/pio.h"
+//
+#include "my_debug.h"
+//
+#include "pio_spi.h"
+#include "pio_spi.pio.h"
+
+#ifndef USE_DBG_PRINTF
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#endif
+
+// The program is loaded once on each PIO, and shared by its state machines
+static bool program_loaded[NUM_PIOS];
+static uint program_offset[NUM_PIOS];
+
+// The clock divider for the fastest clock that does not exceed baudrate
+static uint clkdiv_for(uint baudrate) {
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    uint32_t per_div = baudrate * PIO_SPI_CYCLES_PER_BIT;
+    if (!per_div) return UINT16_MAX;
+    uint32_t div = (sys_hz + per_div - 1) / per_div;
+    if (div < 1) div = 1;
+    if (div > UINT16_MAX) div = UINT16_MAX;
+    return div;
+}
+
+/**
+ * @brief Set the SPI clock frequency.
+ *
+ * @param spi_p Pointer to the SPI object.
+ * @param baudrate The requested frequency in Hertz.
+ * @return The actual frequency: clk_sys / (PIO_SPI_CYCLES_PER_BIT * an integer divider).
+ * A whole divider avoids the jitter of a fractional one.
+ */
+uint pio_spi_set_baudrate(spi_t *spi_p, uint baudrate) {
+    spi_p->pio_clkdiv = clkdiv_for(baudrate);
+    pio_sm_set_clkdiv_int_frac(spi_p->pio, spi_p->pio_sm, spi_p->pio_clkdiv, 0);
+    return pio_spi_get_baudrate(spi_p);
+}
+
+uint pio_spi_get_baudrate(spi_t *spi_p) {
+    return clock_get_hz(clk_sys) / (PIO_SPI_CYCLES_PER_BIT * spi_p->pio_clkdiv);
+}
+
+// Check that the state machine is idle between transfers
+bool pio_spi_chk(spi_t *spi_p) {
+    bool ok = true;
+    if (!pio_sm_is_rx_fifo_empty(spi_p->pio, spi_p->pio_sm)) {
+        DBG_PRINTF("PIO SPI Receive FIFO not empty\n");
+        ok = false;
+    }
+    if (!pio_sm_is_tx_fifo_empty(spi_p->pio, spi_p->pio_sm)) {
+        DBG_PRINTF("PIO SPI Transmit FIFO is not empty\n");
+        ok = false;
+    }
+    return ok;
+}
+
+void pio_spi_dump(spi_t *spi_p) {
+    DBG_PRINTF("PIO%u SM%u PC: %d RXF: %u TXF: %u\n", pio_get_index(spi_p->pio), spi_p->pio_sm,
+               (int)pio_sm_get_pc(spi_p->pio, spi_p->pio_sm) -
+                   (int)program_offset[pio_get_index(spi_p->pio)],
+               pio_sm_get_rx_fifo_level(spi_p->pio, spi_p->pio_sm),
+               pio_sm_get_tx_fifo_level(spi_p->pio, spi_p->pio_sm));
+}
+
+/**
+ * @brief Set up a state machine to be the SPI, at 100 kHz.
+ *
+ * @param spi_p Pointer to the SPI object.
+ * @return true if the initialization is successful, false if the PIO has no room for the
+ * program or no free state machine.
+ *
+ * @details
+ * Only SPI mode 0 is implemented; spi_t::spi_mode is ignored.
+ * The PIO must not be used for SDIO, which takes the whole instruction memory.
+ */
+bool pio_spi_init(spi_t *spi_p) {
+    PIO pio = spi_p->pio;
+    uint pio_ix = pio_get_index(pio);
+    if (!program_loaded[pio_ix]) {
+        if (!pio_can_add_program(pio, &pio_spi_program)) {
+            EMSG_PRINTF("%s: No room for the program on PIO%u\n", __func__, pio_ix);
+            return false;
+        }
+        program_offset[pio_ix] = pio_add_program(pio, &pio_spi_program);
+        program_loaded[pio_ix] = true;
+    }
+    int sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0) {
+        EMSG_PRINTF("%s: No free state machine on PIO%u\n", __func__, pio_ix);
+        return false;
+    }
+    spi_p->pio_sm = sm;
+
+    pio_sm_config cfg = pio_spi_program_get_default_config(program_offset[pio_ix]);
+    sm_config_set_out_pins(&cfg, spi_p->mosi_gpio, 1);
+    sm_config_set_in_pins(&cfg, spi_p->miso_gpio);
+    sm_config_set_sideset_pins(&cfg, spi_p->sck_gpio);
+    // 8 bit frames, MSB first
+    sm_config_set_out_shift(&cfg, false, true, 8);
+    sm_config_set_in_shift(&cfg, false, true, 8);
+    spi_p->pio_clkdiv = clkdiv_for(100 * 1000);
+    sm_config_set_clkdiv_int_frac(&cfg, spi_p->pio_clkdiv, 0);
+
+    // SCK idles low; MOSI starts high
+    uint32_t out_mask = 1u << spi_p->sck_gpio | 1u << spi_p->mosi_gpio;
+    pio_sm_set_pins_with_mask(pio, sm, 1u << spi_p->mosi_gpio, out_mask);
+    pio_sm_set_pindirs_with_mask(pio, sm, out_mask, out_mask | 1u << spi_p->miso_gpio);
+    pio_gpio_init(pio, spi_p->mosi_gpio);
+    pio_gpio_init(pio, spi_p->miso_gpio);
+    pio_gpio_init(pio, spi_p->sck_gpio);
+
+    // This reduces input delay, so MISO can be sampled late in the clock period.
+    // Metastability is unlikely, since the card changes DO on the falling edge.
+    hw_set_bits(&pio->input_sync_bypass, 1u << spi_p->miso_gpio);
+
+    pio_sm_init(pio, sm, program_offset[pio_ix], &cfg);
+    pio_sm_set_enabled(pio, sm, true);
+    return true;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,74 @@
+/* pio_spi.h
+Copyright 2021 Carl John Kugler III
+
+Licensed under the Apache License, Version 2.0 (the License); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an AS IS BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+*/
+
+/* SPI implemented by a PIO state machine
+This is the backend of spi_t when spi_t::pio is set. It takes the place of
+the SPI hardware (PL022) at the lowest level: my_spi.c still does the
+transfers with DMA (to and from the state machine's FIFOs instead of the
+SPI data register), so everything above it works unchanged.
+See pio_spi.pio. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+//
+#include "hardware/pio.h"
+//
+#include "delays.h"
+#include "my_debug.h"
+#include "my_spi.h"
+#include "sd_timeouts.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool pio_spi_init(spi_t *spi_p);
+uint pio_spi_set_baudrate(spi_t *spi_p, uint baudrate);
+uint pio_spi_get_baudrate(spi_t *spi_p);
+bool pio_spi_chk(spi_t *spi_p);
+void pio_spi_dump(spi_t *spi_p);
+
+static inline volatile void *pio_spi_tx_fifo(spi_t *spi_p) {
+    return &spi_p->pio->txf[spi_p->pio_sm];
+}
+static inline volatile void *pio_spi_rx_fifo(spi_t *spi_p) {
+    return &spi_p->pio->rxf[spi_p->pio_sm];
+}
+
+// Send a byte and get the byte received at the same time, without DMA.
+// Returns false, leaving *received_p alone, if nothing was received in time.
+static inline bool pio_spi_write_read(spi_t *spi_p, uint8_t value, uint8_t *received_p) {
+    PIO pio = spi_p->pio;
+    uint sm = spi_p->pio_sm;
+    pio->txf[sm] = (uint32_t)value << 24;  // MSB first
+    uint32_t start = millis();
+    while (pio_sm_is_rx_fifo_empty(pio, sm) && millis() - start < sd_timeouts.sd_spi_write_read)
+        tight_loop_contents();
+    if (pio_sm_is_rx_fifo_empty(pio, sm)) {
+        EMSG_PRINTF("%s: timed out\n", __func__);
+        // Don't let a late byte be taken for the next one
+        pio_sm_clear_fifos(pio, sm);
+        return false;
+    }
+    *received_p = (uint8_t)pio->rxf[sm];
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
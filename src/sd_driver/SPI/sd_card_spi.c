@@ -345,6 +345,23 @@ static uint8_t sd_cmd_spi(sd_card_t *sd_card_p, cmdSupported cmd, uint32_t arg)
 }
 #pragma GCC diagnostic pop
 
+// Number of bytes clocked by each DMA poll of a busy card
+#define SD_BUSY_POLL_LEN 16
+
+/* Card busy tracking
+After a data block has been accepted, the card holds DO low while it programs
+the flash. This is not waited for right away: the card is flagged busy, and
+the wait happens when the next command or data block needs the card.
+Meanwhile, the card can be deselected and the SPI used for other cards. */
+
+// Returns true if the card is still holding DO low
+static bool sd_busy_poll(sd_card_t *sd_card_p) {
+    uint8_t buf[SD_BUSY_POLL_LEN];
+    // Clock a burst of 0xFF with one DMA transfer instead of byte by byte
+    if (!sd_spi_transfer(sd_card_p, NULL, buf, sizeof buf)) return true;
+    return 0xFF != buf[sizeof buf - 1];
+}
+
 /**
  * @brief Wait for the SD card to be ready for the next command.
  *
@@ -358,9 +375,22 @@ static uint8_t sd_cmd_spi(sd_card_t *sd_card_p, cmdSupported cmd, uint32_t arg)
 static bool sd_wait_ready(sd_card_t *sd_card_p, uint32_t timeout) {
     char resp;
 
+    uint32_t start = millis();
+    if (sd_card_p->spi_if_p->state.card_busy) {
+        // Programming takes milliseconds
+        bool busy;
+        do {
+            busy = sd_busy_poll(sd_card_p);
+        } while (busy && millis() - start < timeout);
+        if (busy) {
+            DBG_PRINTF("%s failed\n", __FUNCTION__);
+            return false;
+        }
+        sd_card_p->spi_if_p->state.card_busy = false;
+        return true;
+    }
     // Keep sending dummy clocks with DI held high until the card releases the
     // DO line
-    uint32_t start = millis();
     do {
         resp = sd_spi_write_read(sd_card_p, 0xFF);
     } while (resp != 0xFF && millis() - start < timeout);
@@ -374,20 +404,35 @@ static bool sd_wait_ready(sd_card_t *sd_card_p, uint32_t timeout) {
 }
 
 /* Locks the SD card and acquires its SPI
-Potential optimization: the SPI could be locked separately,
-so if there are multiple SD cards on one SPI,
-another SD card could use the SPI during any gaps
-in the first SD card's utilization.
-However, these gaps are generally small.
+If there are multiple SD cards on one SPI, they take turns with it, in the
+order that they asked for it (see spi_lock in my_spi.h). A long read or
+write gives the SPI up every SD_SPI_MAX_HOLD_MS while another card is
+waiting for it (see sd_yield), so the other card's latency is bounded.
 */
+static void sd_finish_deferred_check(sd_card_t *sd_card_p);
+static block_dev_err_t stop_wr_tran(sd_card_t *sd_card_p);
+static void sd_close_stale_wr(sd_card_t *sd_card_p);
 static void sd_acquire(sd_card_t *sd_card_p) {
     sd_lock(sd_card_p);
+    sd_finish_deferred_check(sd_card_p);
     sd_spi_acquire(sd_card_p);
+    sd_close_stale_wr(sd_card_p);
 }
 static void sd_release(sd_card_t *sd_card_p) {
+    /* A multiple block write is left open in case the next write continues
+    it, but not while another card takes its turn with the SPI */
+    if (sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt && sd_spi_has_waiters(sd_card_p))
+        stop_wr_tran(sd_card_p);  // Ignore return value
     sd_spi_release(sd_card_p);
     sd_unlock(sd_card_p);
 }
+/* Lets the cards waiting for the SPI have their turns, then takes it back.
+The caller must not have a transfer open. */
+static void sd_yield(sd_card_t *sd_card_p) {
+    myASSERT(!sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt);
+    sd_spi_release(sd_card_p);
+    sd_spi_acquire(sd_card_p);
+}
 
 #if TRACE
 static const char *cmd2str(const cmdSupported cmd) {
@@ -441,8 +486,8 @@ static const char *cmd2str(const cmdSupported cmd) {
         // case ACMD13_SD_STATUS:
         case ACMD22_SEND_NUM_WR_BLOCKS:
             return "ACMD22_SEND_NUM_WR_BLOCKS";
-        case ACMD23_SET_WR_BLK_ERASE_COUNT:
-            return "ACMD23_SET_WR_BLK_ERASE_COUNT";
+        case ACMD23_SET_WR_BLK_ERASE_COUNT:  // Same value as CMD23_SET_BLOCK_COUNT
+            return "CMD23_SET_BLOCK_COUNT or ACMD23_SET_WR_BLK_ERASE_COUNT";
         case ACMD41_SD_SEND_OP_COND:
             return "ACMD41_SD_SEND_OP_COND";
         case ACMD42_SET_CLR_CARD_DETECT:
@@ -592,12 +637,14 @@ static block_dev_err_t sd_cmd(sd_card_t *sd_card_p, const cmdSupported cmd, uint
         DBG_PRINTF("No response CMD:%d response: 0x%" PRIx32 "\n", cmd, response);
         return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     }
-    if (response & R1_COM_CRC_ERROR && ACMD23_SET_WR_BLK_ERASE_COUNT != cmd) {
+    // ACMD23 has the same index as CMD23, so only the application command is excused
+    bool pre_erase = isAcmd && ACMD23_SET_WR_BLK_ERASE_COUNT == cmd;
+    if (response & R1_COM_CRC_ERROR && !pre_erase) {
         DBG_PRINTF("CRC error CMD:%d response 0x%" PRIx32 "\n", cmd, response);
         return SD_BLOCK_DEVICE_ERROR_CRC;  // CRC error
     }
     if (response & R1_ILLEGAL_COMMAND) {
-        if (ACMD23_SET_WR_BLK_ERASE_COUNT != cmd)
+        if (!pre_erase)
             DBG_PRINTF("Illegal command CMD:%d response 0x%" PRIx32 "\n", cmd, response);
         if (CMD8_SEND_IF_COND == cmd) {
             // Illegal command is for Ver1 or not SD Card
@@ -753,22 +800,105 @@ static bool sd_wait_token(sd_card_t *sd_card_p, uint8_t token) {
     return false;
 }
 
-static bool chk_crc16(uint8_t *buffer, size_t length, uint16_t crc) {
+// Report a data block CRC check for the adaptive bus clock.
+// A new clock is applied by sd_spi_sync_frequency, once the bus is idle.
+static void sd_spi_clk_feedback(sd_card_t *sd_card_p, bool crc_error) {
+    if (sd_clk_feedback(sd_card_p, 1, crc_error))
+        sd_card_p->state.clk.actual_hz = 0;  // Not applied yet
+}
+static bool cmp_crc16(sd_card_t *sd_card_p, uint16_t crc, uint16_t crc_result) {
+    if (crc_result != crc)
+        DBG_PRINTF("%s: Invalid CRC received: 0x%" PRIx16 " computed: 0x%" PRIx16 "\n",
+                __func__, crc, crc_result);
+    sd_spi_clk_feedback(sd_card_p, crc_result != crc);
+    return (crc_result == crc);
+}
+static bool chk_crc16(sd_card_t *sd_card_p, uint8_t *buffer, size_t length, uint16_t crc) {
     if (crc_on) {
-        uint16_t crc_result;
         // Compute and verify checksum
-        crc_result = crc16(buffer, length);
-        if (crc_result != crc)
-            DBG_PRINTF("%s: Invalid CRC received: 0x%" PRIx16 " computed: 0x%" PRIx16 "\n",
-                    __func__, crc, crc_result);
-        return (crc_result == crc);
+        return cmp_crc16(sd_card_p, crc, crc16(buffer, length));
     }
     return true;
 }
+// Check a received data block, according to the receive CRC policy
+static bool chk_data_crc16(sd_card_t *sd_card_p, uint8_t *buffer, uint16_t crc) {
+    if (!crc_on || !sd_crc_sample(sd_card_p)) return true;
+    if (chk_crc16(sd_card_p, buffer, sd_block_size, crc)) return true;
+    sd_crc_error(sd_card_p, false);
+    return false;
+}
+// Same, for a block whose CRC the DMA sniffer has computed while it was received
+static bool chk_sniffed_crc16(sd_card_t *sd_card_p, uint16_t crc, uint16_t crc_result) {
+    if (!sd_crc_sample(sd_card_p)) return true;
+    if (cmp_crc16(sd_card_p, crc, crc_result)) return true;
+    sd_crc_error(sd_card_p, false);
+    return false;
+}
+// Check the last block of a read under SD_CRC_DEFERRED, before the next operation
+static void sd_finish_deferred_check(sd_card_t *sd_card_p) {
+    uint8_t *buffer = sd_card_p->spi_if_p->state.deferred_buf;
+    if (!buffer) return;
+    sd_card_p->spi_if_p->state.deferred_buf = NULL;
+    if (!chk_crc16(sd_card_p, buffer, sd_block_size, sd_card_p->spi_if_p->state.deferred_crc)) {
+        EMSG_PRINTF("%s: late CRC error\n", __func__);
+        sd_crc_error(sd_card_p, true);
+    }
+}
 
 #define SPI_START_BLOCK (0xFE) /* For Single Block Read/Write and Multiple Block Read */
 
-static block_dev_err_t stop_wr_tran(sd_card_t *sd_card_p);
+// Number of bytes clocked by each DMA burst of the start token scan
+#ifndef SD_TOKEN_SCAN_LEN
+#define SD_TOKEN_SCAN_LEN 16
+#endif
+#define SD_TOKEN_NONE (-1)   // Not received yet
+#define SD_TOKEN_ERROR (-2)  // Data Error token, or the SPI failed
+
+/* Start token scan
+Before a data block, the card sends 0xFF for the read access time, which can
+be hundreds of bytes. Instead of reading these byte by byte, they are clocked
+in bursts of SD_TOKEN_SCAN_LEN with one DMA transfer each. Data bytes that
+arrive in the same burst as the Start Block token are moved to the block
+buffer. Returns the number of data bytes already received, or SD_TOKEN_NONE
+or SD_TOKEN_ERROR. */
+static int sd_scan_token(sd_card_t *sd_card_p, uint8_t *buffer) {
+    uint8_t buf[SD_TOKEN_SCAN_LEN];
+    if (!sd_spi_transfer(sd_card_p, NULL, buf, sizeof buf)) return SD_TOKEN_ERROR;
+    for (size_t i = 0; i < sizeof buf; ++i) {
+        if (0xFF == buf[i]) continue;
+        if (SPI_START_BLOCK != buf[i]) {
+            DBG_PRINTF("%s: Data Error token: 0x%02x\n", __func__, buf[i]);
+            return SD_TOKEN_ERROR;
+        }
+        size_t received = sizeof buf - 1 - i;
+        memcpy(buffer, buf + i + 1, received);
+        return received;
+    }
+    return SD_TOKEN_NONE;
+}
+/* Start the DMA for the rest of a data block.
+Returns true if the DMA sniffer computes the CRC of the block as it arrives
+(seeded with the CRC of the bytes that came with the token); get it with
+sd_spi_get_crc16 when the DMA is complete. */
+static bool sd_read_block_start(sd_card_t *sd_card_p, uint8_t *buffer, int received) {
+    if (crc_on)
+        return sd_spi_transfer_start_crc16(sd_card_p, NULL, buffer + received,
+                                           sd_block_size - received,
+                                           crc16_update(0, buffer, received));
+    sd_spi_transfer_start(sd_card_p, NULL, buffer + received, sd_block_size - received);
+    return false;
+}
+// Wait for the Start Block token, then start receiving the block
+static bool sd_wait_block(sd_card_t *sd_card_p, uint8_t *buffer, bool *sniffed_p) {
+    uint32_t start = millis();
+    int received;
+    do {
+        received = sd_scan_token(sd_card_p, buffer);
+    } while (SD_TOKEN_NONE == received && millis() - start < sd_timeouts.sd_command);
+    if (received < 0) return false;
+    *sniffed_p = sd_read_block_start(sd_card_p, buffer, received);
+    return true;
+}
 
 static block_dev_err_t read_bytes(sd_card_t *sd_card_p, uint8_t *buffer, uint32_t length) {
     uint16_t crc;
@@ -785,7 +915,7 @@ static block_dev_err_t read_bytes(sd_card_t *sd_card_p, uint8_t *buffer, uint32_
     crc = (sd_spi_read(sd_card_p) << 8);
     crc |= sd_spi_read(sd_card_p);
 
-    if (!chk_crc16(buffer, length, crc)) {
+    if (!chk_crc16(sd_card_p, buffer, length, crc)) {
         DBG_PRINTF("%s: Invalid CRC received: 0x%" PRIx16 "\n", __func__, crc);
         return SD_BLOCK_DEVICE_ERROR_CRC;
     }
@@ -795,11 +925,15 @@ static block_dev_err_t read_bytes(sd_card_t *sd_card_p, uint8_t *buffer, uint32_
  * @brief Read a block of data from the SD card.
  *
  * @param sd_card_p pointer to sd_card_t structure
- * @param buffer pointer to the buffer to store the data
+ * @param iov array of segments to store the data, filled in order
+ * @param iovcnt the number of segments
  * @param data_address the address of the block to read
- * @param num_rd_blks the number of blocks to read
+ * @param num_rd_blks the number of blocks to read (the total of the segments)
+ * @param blks_done_p the number of blocks already read (by an earlier call
+ *                    that yielded the SPI); updated when this one yields
  *
- * @return error code
+ * @return error code, or SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK if the read
+ *         stopped early to let another card use the SPI
  *
  * @details
  * This function checks if the SD card is initialized and has a valid disk,
@@ -811,18 +945,34 @@ static block_dev_err_t read_bytes(sd_card_t *sd_card_p, uint8_t *buffer, uint32_
  * the CRC16 checksum for each block. If the two match, the function continues
  * to the next block. If the number of blocks to read is greater than 1, it
  * sends CMD12 to stop the transmission after all blocks have been
- * read. It then checks the CRC16 checksum for the last block and returns the
- * error code.
+ * read, unless the block count was declared beforehand with CMD23.
+ * It then checks the CRC16 checksum for the last block (unless the receive
+ * CRC policy defers it) and returns the error code.
+ * If the SPI has been held for SD_SPI_MAX_HOLD_MS and another card is
+ * waiting for it, the transfer is stopped between blocks.
  */
-static block_dev_err_t in_sd_read_blocks(sd_card_t *sd_card_p, uint8_t *buffer,
-                                         const uint32_t data_address,
-                                         const uint32_t num_rd_blks) {
+static block_dev_err_t in_sd_read_blocks(sd_card_t *sd_card_p,
+                                         const sd_iovec_t *iov, uint32_t iovcnt,
+                                         uint32_t data_address,
+                                         uint32_t num_rd_blks,
+                                         uint32_t *blks_done_p) {
     if (sd_card_p->state.m_Status & (STA_NOINIT | STA_NODISK))
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
     if (!num_rd_blks) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
     if (data_address + num_rd_blks > sd_card_p->state.sectors)
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
 
+    // Skip the blocks that were read before the SPI was yielded
+    uint32_t skip = *blks_done_p;
+    myASSERT(skip < num_rd_blks);
+    data_address += skip;
+    num_rd_blks -= skip;
+    while (skip >= iov->count) {
+        skip -= iov->count;
+        ++iov;
+        --iovcnt;
+    }
+
     block_dev_err_t status = SD_BLOCK_DEVICE_ERROR_NONE;
 
     // Stop any ongoing write transmission
@@ -831,6 +981,16 @@ static block_dev_err_t in_sd_read_blocks(sd_card_t *sd_card_p, uint8_t *buffer,
         if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
     }
 
+    // Declare the number of blocks with CMD23, if possible, to save the CMD12
+    bool blk_cnt_set = false;
+    if (num_rd_blks > 1 && sd_use_cmd23(sd_card_p)) {
+        if (SD_BLOCK_DEVICE_ERROR_NONE ==
+            sd_cmd(sd_card_p, CMD23_SET_BLOCK_COUNT, num_rd_blks, false, 0))
+            blk_cnt_set = true;
+        else
+            sd_card_p->state.cmd23_supported = false;  // Fall back to CMD12
+    }
+
     // Send command to receive data
     if (num_rd_blks == 1)
         status = sd_cmd(sd_card_p, CMD17_READ_SINGLE_BLOCK, data_address, false, 0);
@@ -839,28 +999,38 @@ static block_dev_err_t in_sd_read_blocks(sd_card_t *sd_card_p, uint8_t *buffer,
     if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
 
     /* Optimization:
-    While the DMA is busy transfering the block data,
+    If the DMA sniffer is free, it computes the CRC of each block as it
+    arrives. Otherwise, while the DMA is busy transfering the block data,
     use the some of the wait time to check the CRC
     for the previous block.
     */
     uint16_t prev_block_crc = 0;
     uint8_t *prev_buffer_addr = 0;
     uint32_t blk_cnt = num_rd_blks;
+    uint8_t *buffer = iov->buffer + skip * sd_block_size;
+    uint32_t seg_cnt = iov->count - skip;
 
     // receive the data : one block at a time
     while (blk_cnt) {
-        // read until start byte (0xFE)
-        if (!sd_wait_token(sd_card_p, SPI_START_BLOCK)) {
+        // Move on to the next segment
+        while (!seg_cnt) {
+            ++iov;
+            --iovcnt;
+            myASSERT(iovcnt);
+            buffer = iov->buffer;
+            seg_cnt = iov->count;
+        }
+        // Read until start byte (0xFE), then read data
+        bool sniffed = false;
+        if (!sd_wait_block(sd_card_p, buffer, &sniffed)) {
             DBG_PRINTF("%s:%d Read timeout\n", __func__, __LINE__);
             return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
         }
-        // read data
-        sd_spi_transfer_start(sd_card_p, NULL, buffer, sd_block_size);
 
         // Check the CRC16 checksum for the previous data block
         if (prev_buffer_addr) {
             // Check previous block's CRC:
-            if (!chk_crc16(prev_buffer_addr, sd_block_size, prev_block_crc)) {
+            if (!chk_data_crc16(sd_card_p, prev_buffer_addr, prev_block_crc)) {
                 DBG_PRINTF("%s: Invalid CRC received: 0x%" PRIx16 "\n", __func__,
                            prev_block_crc);
                 return SD_BLOCK_DEVICE_ERROR_CRC;
@@ -870,44 +1040,90 @@ static block_dev_err_t in_sd_read_blocks(sd_card_t *sd_card_p, uint8_t *buffer,
         uint32_t timeout = calculate_transfer_time_ms(sd_card_p->spi_if_p->spi, sd_block_size);
         bool ok = sd_spi_transfer_wait_complete(sd_card_p, timeout);
         if (!ok) return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+        uint16_t sniffed_crc = sniffed ? sd_spi_get_crc16(sd_card_p) : 0;
 
         // Read the CRC16 checksum for the data block
         prev_block_crc = sd_spi_read(sd_card_p) << 8;
         prev_block_crc |= sd_spi_read(sd_card_p);
         prev_buffer_addr = buffer;
+        if (sniffed) {
+            // Nothing left to compute
+            if (!chk_sniffed_crc16(sd_card_p, prev_block_crc, sniffed_crc)) {
+                DBG_PRINTF("%s: Invalid CRC received: 0x%" PRIx16 "\n", __func__,
+                           prev_block_crc);
+                return SD_BLOCK_DEVICE_ERROR_CRC;
+            }
+            prev_buffer_addr = NULL;
+        }
         buffer += sd_block_size;
+        --seg_cnt;
         --blk_cnt;
+
+        if (blk_cnt && sd_spi_should_yield(sd_card_p)) {
+            // Stop here, and let the caller give the other cards their turns
+            status = sd_cmd(sd_card_p, CMD12_STOP_TRANSMISSION, 0x0, false, 0);
+            if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
+            if (prev_buffer_addr && !chk_data_crc16(sd_card_p, prev_buffer_addr, prev_block_crc))
+                return SD_BLOCK_DEVICE_ERROR_CRC;
+            *blks_done_p += num_rd_blks - blk_cnt;
+            return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+        }
     }
 
-    if (num_rd_blks > 1) {
+    if (num_rd_blks > 1 && !blk_cnt_set) {
         // Send CMD12(0x00000000) to stop the transmission for multi-block transfer
         status = sd_cmd(sd_card_p, CMD12_STOP_TRANSMISSION, 0x0, false, 0);
         if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
     }
-    // Check final block's CRC:
-    if (!chk_crc16(prev_buffer_addr, sd_block_size, prev_block_crc)) {
+    if (!prev_buffer_addr) return status;  // Checked already
+    // Check final block's CRC, or leave it for the start of the next operation
+    if (SD_CRC_DEFERRED == sd_card_p->rx_crc_policy && crc_on) {
+        sd_crc_sample(sd_card_p);  // Counts it as checked
+        memcpy(sd_card_p->spi_if_p->state.deferred_block, prev_buffer_addr, sd_block_size);
+        sd_card_p->spi_if_p->state.deferred_buf = sd_card_p->spi_if_p->state.deferred_block;
+        sd_card_p->spi_if_p->state.deferred_crc = prev_block_crc;
+        return status;
+    }
+    if (!chk_data_crc16(sd_card_p, prev_buffer_addr, prev_block_crc)) {
         DBG_PRINTF("%s: Invalid CRC received: 0x%" PRIx16 "\n", __func__, prev_block_crc);
         return SD_BLOCK_DEVICE_ERROR_CRC;
     }
     return status;
 }
-static block_dev_err_t sd_read_blocks(sd_card_t *sd_card_p, uint8_t *buffer,
-                                      uint32_t data_address, uint32_t num_rd_blks) {
-    TRACE_PRINTF("sd_read_blocks(0x%p, 0x%lx, 0x%lx)\n", buffer, data_address, num_rd_blks);
+static block_dev_err_t sd_read_blocks_v(sd_card_t *sd_card_p, const sd_iovec_t *iov,
+                                        uint32_t iovcnt, uint32_t data_address) {
+    uint32_t num_rd_blks = sd_iov_blocks(iov, iovcnt);
     sd_acquire(sd_card_p);
     unsigned retries = sd_timeouts.sd_command_retries;
+    uint32_t blks_done = 0;
     block_dev_err_t status;
     do {
-        status = in_sd_read_blocks(sd_card_p, buffer, data_address, num_rd_blks);
+        status = in_sd_read_blocks(sd_card_p, iov, iovcnt, data_address, num_rd_blks,
+                                   &blks_done);
+        if (SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK == status) {
+            sd_yield(sd_card_p);
+            continue;  // Not a retry
+        }
         if (status != SD_BLOCK_DEVICE_ERROR_NONE) {
+            // CMD12 is harmless, but may be rejected, if the read was bounded by CMD23
             if (SD_BLOCK_DEVICE_ERROR_NONE !=
-                    sd_cmd(sd_card_p, CMD12_STOP_TRANSMISSION, 0x0, false, 0))
+                    sd_cmd(sd_card_p, CMD12_STOP_TRANSMISSION, 0x0, false, 0) &&
+                !sd_use_cmd23(sd_card_p))
                 break;
+            // Retry at the new clock, if the CRC errors changed it
+            sd_spi_sync_frequency(sd_card_p);
         }
-    } while (--retries && status != SD_BLOCK_DEVICE_ERROR_NONE);
+    } while (status != SD_BLOCK_DEVICE_ERROR_NONE &&
+             (SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK == status || --retries));
     sd_release(sd_card_p);
     return status;
 }
+static block_dev_err_t sd_read_blocks(sd_card_t *sd_card_p, uint8_t *buffer,
+                                      uint32_t data_address, uint32_t num_rd_blks) {
+    TRACE_PRINTF("sd_read_blocks(0x%p, 0x%lx, 0x%lx)\n", buffer, data_address, num_rd_blks);
+    sd_iovec_t iov = {buffer, num_rd_blks};
+    return sd_read_blocks_v(sd_card_p, &iov, 1, data_address);
+}
 
 /**
  * @brief Send the numbers of the well written (without errors) blocks.
@@ -948,63 +1164,135 @@ static block_dev_err_t get_num_wr_blocks(sd_card_t *sd_card_p, uint32_t *num_p)
     return SD_BLOCK_DEVICE_ERROR_NONE;
 }
 
+/* Write coalescing
+FatFs writes its FAT, directory, and file buffers one sector at a time.
+Instead of a CMD24 and a CMD13 status check for each of these, a single
+block write is sent as the start of an open-ended CMD25. This is left open,
+like any multiple block write, so that a write to the next sector continues
+it without a command. The CMD13 is sent once for the whole run, when the
+run is stopped: by a write elsewhere, a read, a sync, another card's turn
+with the SPI, or a write that comes more than SD_SPI_WR_COALESCE_MS after
+the run's last block. 0 disables this, and the time limit on continuing
+multiple block writes.
+Until the run is stopped, a programming error in it can't be reported, so
+call sync (f_sync, or disk_ioctl CTRL_SYNC) to find out whether the data
+was written. A run that has gone stale is stopped the next time the driver
+is entered for the card, and an error is logged.
+*/
+#ifndef SD_SPI_WR_COALESCE_MS
+#define SD_SPI_WR_COALESCE_MS 250
+#endif
+
+// True if the open multiple block write is too old to continue
+static bool sd_wr_stale(sd_card_t *sd_card_p) {
+    return SD_SPI_WR_COALESCE_MS &&
+           millis() - sd_card_p->spi_if_p->state.wr_run_time >= SD_SPI_WR_COALESCE_MS;
+}
+// True if a write of num_wrt_blks to data_address can continue the open
+// multiple block write. A write declared with CMD23 only takes the blocks
+// it still has to come.
+static bool sd_wr_continues(sd_card_t *sd_card_p, uint32_t data_address, uint32_t num_wrt_blks) {
+    sd_spi_if_state_t *state_p = &sd_card_p->spi_if_p->state;
+    return state_p->ongoing_mlt_blk_wrt &&
+           (!state_p->blk_cnt_set || num_wrt_blks <= state_p->wr_blks_left) &&
+           state_p->cont_sector_wrt == data_address && !sd_wr_stale(sd_card_p);
+}
+// Stop an open multiple block write that has gone stale
+static void sd_close_stale_wr(sd_card_t *sd_card_p) {
+    if (!sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt || !sd_wr_stale(sd_card_p)) return;
+    block_dev_err_t status = stop_wr_tran(sd_card_p);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status)
+        EMSG_PRINTF("%s: coalesced write failed: %d\n", sd_get_drive_prefix(sd_card_p),
+                    status);
+}
+
+// Bytes clocked after the CRC of a data block: the data response token,
+// then a first busy poll
+#define SD_WR_TRAILER_LEN (1 + SD_BUSY_POLL_LEN)
+
+// CRC16 to send with a data block
+static uint16_t block_crc16(const uint8_t *buffer, uint32_t length) {
+    if (!crc_on) return (~0);
+    return crc16((void *)buffer, length);
+}
+/* Start the DMA for a data block to send.
+Returns true if the DMA sniffer computes the CRC of the block as it goes;
+get it with sd_spi_get_crc16 when the DMA is complete. */
+static bool sd_write_block_start(sd_card_t *sd_card_p, const uint8_t *buffer, uint32_t length) {
+    if (crc_on) return sd_spi_transfer_start_crc16(sd_card_p, buffer, NULL, length, 0);
+    sd_spi_transfer_start(sd_card_p, buffer, NULL, length);
+    return false;
+}
+
 /**
- * @brief Send a single block of data to the SD card.
+ * @brief Start sending a block of data to the SD card.
+ *
+ * Waits for the card to finish programming the previous block, sends the
+ * token, and starts the DMA for the data. Finish with end_block().
  *
  * @param sd_card_p Pointer to the SD card object.
  * @param buffer Pointer to the buffer containing the data to be sent.
  * @param token The token to be sent before the data.
  * @param length The length of the data to be sent.
+ * @param sniffed_p Set to true if the DMA sniffer computes the CRC16 of the data.
  *
  * @return Block device error code.
- *
- * @details
- * The function sends a single block of data to the SD card. It starts by sending the start block
- * token, then writes the data using the SPI transfer function. While the SPI transfer is ongoing,
- * the function computes the CRC16 checksum of the data if CRC checking is enabled. After the SPI
- * transfer is complete, the function writes the CRC16 checksum to the SD card. Finally, the function
- * checks the response token and returns an error code if the data was not accepted.
  */
-static block_dev_err_t send_block(sd_card_t *sd_card_p, const uint8_t *buffer, uint8_t token,
-                                     uint32_t length)
-{
-    uint8_t response;
+static block_dev_err_t start_block(sd_card_t *sd_card_p, const uint8_t *buffer, uint8_t token,
+                                   uint32_t length, bool *sniffed_p) {
+    // Wait for the card to finish programming the previous block
+    if (sd_card_p->spi_if_p->state.card_busy &&
+        false == sd_wait_ready(sd_card_p, sd_timeouts.sd_command)) {
+        DBG_PRINTF("%s:%d: Card not ready yet\n", __func__, __LINE__);
+        return SD_BLOCK_DEVICE_ERROR_WRITE;
+    }
 
     /* Indicate start of block - Start Block Token */
-    response = sd_spi_write_read(sd_card_p, token);
+    uint8_t response = sd_spi_write_read(sd_card_p, token);
     if (!response) {
         DBG_PRINTF("Start Block Token not accepted. Response: 0x%x\n", response);
         return SD_BLOCK_DEVICE_ERROR_WRITE;
     }
 
     // Write the data
-    sd_spi_transfer_start(sd_card_p, buffer, NULL, length);
-
-    /* Optimization:
-    While the DMA is busy transfering the block data,
-    use the some of the wait time to calculate the CRC.
-    Typically, DMA transfer of the block data takes about 244 us,
-    but the CRC16 calculation takes only about 66 us.
-    */
+    *sniffed_p = sd_write_block_start(sd_card_p, buffer, length);
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
 
-    uint16_t crc = (~0);
-    // While DMA transfers the block, compute CRC:
-    if (crc_on) {
-        // Compute CRC
-        crc = crc16((void *)buffer, length);
-    }
+/**
+ * @brief Finish sending a block of data to the SD card.
+ *
+ * @param sd_card_p Pointer to the SD card object.
+ * @param length The length of the data being sent.
+ * @param sniffed True if the DMA sniffer computes the CRC16 of the data.
+ * @param crc The CRC16 of the data, if not sniffed.
+ *
+ * @return Block device error code.
+ *
+ * @details
+ * Waits for the DMA of the data to complete. Then the CRC16 is sent, the
+ * response token is read, and the first busy poll is clocked, all in one
+ * DMA transfer. Returns an error code if the data was not accepted.
+ */
+static block_dev_err_t end_block(sd_card_t *sd_card_p, uint32_t length, bool sniffed,
+                                 uint16_t crc) {
     uint32_t timeout = calculate_transfer_time_ms(sd_card_p->spi_if_p->spi, length);
     bool ok = sd_spi_transfer_wait_complete(sd_card_p, timeout);
     if (!ok) return SD_BLOCK_DEVICE_ERROR_WRITE;
+    if (sniffed) crc = sd_spi_get_crc16(sd_card_p);
 
-    // Write the checksum CRC16
-    sd_spi_write(sd_card_p, crc >> 8);
-    sd_spi_write(sd_card_p, crc);
+    // Write the checksum CRC16, then clock in the response token and busy
+    uint8_t tx[2 + SD_WR_TRAILER_LEN];
+    uint8_t rx[2 + SD_WR_TRAILER_LEN];
+    memset(tx, SPI_FILL_CHAR, sizeof tx);
+    tx[0] = crc >> 8;
+    tx[1] = crc;
+    if (!sd_spi_transfer(sd_card_p, tx, rx, sizeof tx)) return SD_BLOCK_DEVICE_ERROR_WRITE;
 
     block_dev_err_t rc = SD_BLOCK_DEVICE_ERROR_NONE;
 
     // Check the response token
-    response = sd_spi_read(sd_card_p);
+    uint8_t response = rx[2];
 
     // Only CRC and general write error are communicated via response token
     if ((response & SPI_DATA_RESPONSE_MASK) != SPI_DATA_ACCEPTED) {
@@ -1030,13 +1318,38 @@ static block_dev_err_t send_block(sd_card_t *sd_card_p, const uint8_t *buffer, u
 
         rc = SD_BLOCK_DEVICE_ERROR_WRITE;
     }
-    // Wait while card is busy programming
-    if (false == sd_wait_ready(sd_card_p, sd_timeouts.sd_command)) {
-        DBG_PRINTF("%s:%d: Card not ready yet\n", __func__, __LINE__);
-        rc = SD_BLOCK_DEVICE_ERROR_WRITE;
-    }
+    if (crc_on) sd_spi_clk_feedback(sd_card_p, (response & SPI_DATA_RESPONSE_MASK) == SPI_DATA_CRC_ERROR);
+    // The card is busy programming until it releases DO
+    sd_card_p->spi_if_p->state.card_busy = 0xFF != rx[sizeof rx - 1];
     return rc;
 }
+
+/**
+ * @brief Send a single block of data to the SD card.
+ *
+ * @param sd_card_p Pointer to the SD card object.
+ * @param buffer Pointer to the buffer containing the data to be sent.
+ * @param token The token to be sent before the data.
+ * @param length The length of the data to be sent.
+ *
+ * @return Block device error code.
+ *
+ * @details
+ * If CRC checking is enabled, the DMA sniffer computes the CRC16 checksum of
+ * the data as it goes. If the sniffer is in use for another SPI, the function
+ * computes it while the DMA sends the data instead.
+ * Typically, DMA transfer of the block data takes about 244 us,
+ * but the CRC16 calculation takes only about 66 us.
+ */
+static block_dev_err_t send_block(sd_card_t *sd_card_p, const uint8_t *buffer, uint8_t token,
+                                     uint32_t length)
+{
+    bool sniffed;
+    block_dev_err_t rc = start_block(sd_card_p, buffer, token, length, &sniffed);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != rc) return rc;
+    uint16_t crc = sniffed ? 0 : block_crc16(buffer, length);
+    return end_block(sd_card_p, length, sniffed, crc);
+}
 /**
  * @brief Send all blocks of data, one block at a time.
  * 
@@ -1044,9 +1357,12 @@ static block_dev_err_t send_block(sd_card_t *sd_card_p, const uint8_t *buffer, u
  *  - Sends each block of data using the send_block() function
  *  - Checks the status of each send operation and stop if there is an error
  *  - Updates the buffer pointer and data address after each send operation
- *  - Sets the ongoing_mlt_blk_wrt flag to true if all blocks are sent successfully
+ *  - Sets the ongoing_mlt_blk_wrt flag to true if all blocks are sent successfully,
+ *    unless the number of blocks was declared with CMD23
  *  - Otherwise, stops the ongoing multiblock write and resets the number of
  *    blocks requested
+ *  - Stops the write early, between blocks, if another card has been waiting
+ *    for the SPI for SD_SPI_MAX_HOLD_MS
  * 
  * @param sd_card_p Pointer to the SD card object.
  * @param buffer_p Pointer to the array of const uint8_t pointers. Each pointer
@@ -1056,23 +1372,59 @@ static block_dev_err_t send_block(sd_card_t *sd_card_p, const uint8_t *buffer, u
  * @param num_wrt_blks_p Pointer to the number of blocks to be written.
  * 
  * @return SD_BLOCK_DEVICE_ERROR_NONE if all blocks are sent successfully,
- *         otherwise an error code.
+ *         SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK if the write was stopped early
+ *         to yield the SPI, otherwise an error code.
  */
 static block_dev_err_t send_all_blocks(sd_card_t *sd_card_p, const uint8_t *buffer_p[],
         uint32_t * const data_address_p,
         uint32_t * const num_wrt_blks_p)
 {
     block_dev_err_t status;
+    /* Pipeline:
+    The DMA sniffer computes the CRC of each block as it goes. If the
+    sniffer is in use for another SPI, the CRC of each block is computed
+    while the DMA sends the block before it, so it is ready as soon as the
+    block's own DMA is done. */
+    uint16_t crc = 0;
+    bool crc_ready = false;  // crc has been computed for this block
     do {
-        status = send_block(sd_card_p, *buffer_p, SPI_START_BLK_MUL_WRITE, sd_block_size);
+        bool sniffed;
+        status = start_block(sd_card_p, *buffer_p, SPI_START_BLK_MUL_WRITE, sd_block_size,
+                             &sniffed);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != status) break;
+        uint16_t next_crc = 0;
+        bool next_crc_ready = false;
+        if (!sniffed) {
+            if (!crc_ready) crc = block_crc16(*buffer_p, sd_block_size);
+            if (*num_wrt_blks_p > 1) {
+                next_crc = block_crc16(*buffer_p + sd_block_size, sd_block_size);
+                next_crc_ready = true;
+            }
+        }
+        status = end_block(sd_card_p, sd_block_size, sniffed, crc);
         if (SD_BLOCK_DEVICE_ERROR_NONE != status) break;
+        crc = next_crc;
+        crc_ready = next_crc_ready;
         *buffer_p += sd_block_size;
         ++*data_address_p;
+        if (sd_card_p->spi_if_p->state.blk_cnt_set) --sd_card_p->spi_if_p->state.wr_blks_left;
+        if (1 < *num_wrt_blks_p && sd_spi_should_yield(sd_card_p)) {
+            // Close the write, and let the caller give the other cards their turns
+            --*num_wrt_blks_p;
+            status = stop_wr_tran(sd_card_p);
+            return SD_BLOCK_DEVICE_ERROR_NONE == status ? SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK
+                                                        : status;
+        }
     } while (--*num_wrt_blks_p);
     if (SD_BLOCK_DEVICE_ERROR_NONE == status) {
         myASSERT(!*num_wrt_blks_p);
-        sd_card_p->spi_if_p->state.cont_sector_wrt = *data_address_p;
-        sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt = true;
+        // With CMD23, the card ends the write after the declared number of blocks.
+        // Until then, the rest of them can follow.
+        if (!sd_card_p->spi_if_p->state.blk_cnt_set || sd_card_p->spi_if_p->state.wr_blks_left) {
+            sd_card_p->spi_if_p->state.cont_sector_wrt = *data_address_p;
+            sd_card_p->spi_if_p->state.wr_run_time = millis();
+            sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt = true;
+        }
     } else {
         // sd_card_p->spi_if_p->state.n_wrt_blks_reqd cleared in stop_wr_tran
         uint32_t n_wrt_blks_reqd = sd_card_p->spi_if_p->state.n_wrt_blks_reqd;
@@ -1082,11 +1434,34 @@ static block_dev_err_t send_all_blocks(sd_card_t *sd_card_p, const uint8_t *buff
         if (SD_BLOCK_DEVICE_ERROR_NONE == err) {
             DBG_PRINTF("blocks_requested: %lu, NUM_WR_BLOCKS: %lu\n",
                     n_wrt_blks_reqd, nw);
-            *num_wrt_blks_p = n_wrt_blks_reqd - nw;
+            /* The run may have started with earlier writes, whose blocks
+            can't be sent again from here */
+            if (n_wrt_blks_reqd - nw < *num_wrt_blks_p) *num_wrt_blks_p = n_wrt_blks_reqd - nw;
         }
     }
     return status;
 }
+/* Before a CMD25, tell the card how many blocks are coming: ACMD23, to let
+it erase them ahead of the write, and CMD23, if possible, to save the Stop
+Tran token. A single block is left open-ended, so that writes to the next
+sectors can join it. */
+static void sd_wr_declare_count(sd_card_t *sd_card_p, uint32_t num_wrt_blks) {
+    // Let the card erase the blocks ahead of the write
+    uint32_t pre_erase = sd_pre_erase_count(sd_card_p, num_wrt_blks);
+    if (pre_erase && SD_BLOCK_DEVICE_ERROR_UNSUPPORTED ==
+                         sd_cmd(sd_card_p, ACMD23_SET_WR_BLK_ERASE_COUNT, pre_erase, true, 0))
+        sd_card_p->state.pre_erase_supported = false;
+
+    sd_card_p->spi_if_p->state.blk_cnt_set = false;
+    if (1 < num_wrt_blks && sd_use_cmd23(sd_card_p)) {
+        if (SD_BLOCK_DEVICE_ERROR_NONE ==
+            sd_cmd(sd_card_p, CMD23_SET_BLOCK_COUNT, num_wrt_blks, false, 0)) {
+            sd_card_p->spi_if_p->state.blk_cnt_set = true;
+            sd_card_p->spi_if_p->state.wr_blks_left = num_wrt_blks;
+        } else
+            sd_card_p->state.cmd23_supported = false;  // Fall back to Stop Tran
+    }
+}
 /**
  * @brief Write multiple blocks of data to the SD card.
  * 
@@ -1101,18 +1476,22 @@ static block_dev_err_t send_all_blocks(sd_card_t *sd_card_p, const uint8_t *buff
  * @param data_address_p Pointer to the integer storing the data address.
  * @param num_wrt_blks_p Pointer to the integer storing the number of blocks to
  *                       write.
- * @return block_dev_err_t Error code indicating the status of the write operation.
+ * @param blks_after Number of blocks that the caller will write right after
+ *                   these, to the following sectors. They are declared along
+ *                   with these, so that they continue the same write.
+ * @return block_dev_err_t Error code indicating the status of the write operation,
+ *         or SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK if it stopped early to yield the SPI.
  */
 static block_dev_err_t in_sd_write_blocks(sd_card_t *sd_card_p, 
                                           const uint8_t *buffer_p[],
                                           uint32_t * const data_address_p,
-                                          uint32_t * const num_wrt_blks_p)
+                                          uint32_t * const num_wrt_blks_p,
+                                          uint32_t blks_after)
 {
     block_dev_err_t status = SD_BLOCK_DEVICE_ERROR_NONE;
 
-    /* Continue a multiblock write */
-    if (sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt &&
-        	sd_card_p->spi_if_p->state.cont_sector_wrt == *data_address_p) {
+    /* Continue a multiblock write, unless it has gone stale */
+    if (sd_wr_continues(sd_card_p, *data_address_p, *num_wrt_blks_p)) {
         // Update the number of blocks requested for write
         sd_card_p->spi_if_p->state.n_wrt_blks_reqd += *num_wrt_blks_p;
         // Send all blocks of data
@@ -1125,6 +1504,8 @@ static block_dev_err_t in_sd_write_blocks(sd_card_t *sd_card_p,
         if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
     }
 
+    sd_wr_declare_count(sd_card_p, *num_wrt_blks_p + blks_after);
+
     // Send command to perform write operation
     status = sd_cmd(sd_card_p, CMD25_WRITE_MULTIPLE_BLOCK, *data_address_p, false, 0);
     if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
@@ -1147,8 +1528,10 @@ static block_dev_err_t stop_wr_tran(sd_card_t *sd_card_p) {
     sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt = false;
     /* In a Multiple Block write operation, the stop transmission will be
      * done by sending 'Stop Tran' token instead of 'Start Block' token at
-     * the beginning of the next block
+     * the beginning of the next block, which has to wait until the card is
+     * ready. (If it doesn't get ready, the CMD13 below fails.)
      */
+    if (sd_card_p->spi_if_p->state.card_busy) sd_wait_ready(sd_card_p, sd_timeouts.sd_command);
     sd_spi_write(sd_card_p, SPI_STOP_TRAN);
     /*
     Once the programming operation is completed, the
@@ -1160,10 +1543,8 @@ static block_dev_err_t stop_wr_tran(sd_card_t *sd_card_p) {
     performed on the data block and communicated to
     the host via the data-response token is CRC.
     */
-
-    if (false == sd_wait_ready(sd_card_p, sd_timeouts.sd_command)) {
-        DBG_PRINTF("Card not ready yet\n");
-    }
+    // sd_cmd waits for the programming to finish
+    sd_card_p->spi_if_p->state.card_busy = true;
 
     uint32_t stat = 0;
     sd_card_p->spi_if_p->state.n_wrt_blks_reqd = 0;
@@ -1215,6 +1596,31 @@ static block_dev_err_t write_block(sd_card_t *sd_card_p, const uint8_t *buffer,
 
     return status;
 }
+// Write multiple blocks, retrying the operation until it succeeds or reaches the maximum number of retries.
+// blks_after: as for in_sd_write_blocks
+static block_dev_err_t sd_write_blocks_retry(sd_card_t *sd_card_p, const uint8_t *buffer,
+                                             uint32_t data_address, uint32_t num_wrt_blks,
+                                             uint32_t blks_after) {
+    unsigned retries = sd_timeouts.sd_command_retries;
+    block_dev_err_t status;
+    do {
+        if (retries < sd_timeouts.sd_command_retries) {
+            DBG_PRINTF("Retrying\n");
+            sd_spi_sync_frequency(sd_card_p);
+        }
+        status = in_sd_write_blocks(sd_card_p, &buffer, &data_address, &num_wrt_blks, blks_after);
+        if (SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK == status) {
+            // Stopped early for another card. Not a retry.
+            sd_yield(sd_card_p);
+            continue;
+        }
+        if (SD_BLOCK_DEVICE_ERROR_WRITE == status)
+            DBG_PRINTF("%s status=0x%x data_address=%lu num_wrt_blks=%lu\n", sd_get_drive_prefix(sd_card_p), status, data_address, num_wrt_blks);
+    } while ((SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK == status ||
+              (SD_BLOCK_DEVICE_ERROR_WRITE == status && --retries)) &&
+             num_wrt_blks);
+    return status;
+}
 /**
  * @brief Programs blocks to a block device
  *
@@ -1260,18 +1666,11 @@ static block_dev_err_t sd_write_blocks(sd_card_t *sd_card_p, uint8_t const buffe
 
     block_dev_err_t status;
 
-    // If writing only one block, use the optimized function
-    if (1 == num_wrt_blks) {
+    // If writing only one block, without write coalescing, use the optimized function
+    if (1 == num_wrt_blks && !SD_SPI_WR_COALESCE_MS) {
         status = write_block(sd_card_p, buffer, data_address);
     } else {
-        // If writing multiple blocks, retry the operation until it succeeds or reaches the maximum number of retries
-        unsigned retries = sd_timeouts.sd_command_retries;
-        do {
-            if (retries < sd_timeouts.sd_command_retries) DBG_PRINTF("Retrying\n");
-            status = in_sd_write_blocks(sd_card_p, &buffer, &data_address, &num_wrt_blks);
-            if (SD_BLOCK_DEVICE_ERROR_WRITE == status)
-                DBG_PRINTF("%s status=0x%x data_address=%lu num_wrt_blks=%lu\n", sd_get_drive_prefix(sd_card_p), status, data_address, num_wrt_blks);
-        } while (SD_BLOCK_DEVICE_ERROR_WRITE == status && --retries && num_wrt_blks);
+        status = sd_write_blocks_retry(sd_card_p, buffer, data_address, num_wrt_blks, 0);
     }
 
     // Release the SD card
@@ -1280,6 +1679,55 @@ static block_dev_err_t sd_write_blocks(sd_card_t *sd_card_p, uint8_t const buffe
     return status;
 }
 
+/**
+ * @brief Programs blocks to a block device from a list of segments
+ *
+ * The segments are written to consecutive blocks. The blocks of all of the
+ * segments are declared at once (CMD23, when the card supports it), and
+ * each segment continues the write where the previous one left off, so
+ * they all go in a single CMD25.
+ *
+ * @param[in] sd_card_p Pointer to the SD card
+ * @param[in] iov Segments of data to write to blocks
+ * @param[in] iovcnt Number of segments
+ * @param[in] data_address Logical Address of block to begin writing to (LBA)
+ *
+ * @return Same as sd_write_blocks
+ */
+static block_dev_err_t sd_write_blocks_v(sd_card_t *sd_card_p, const sd_iovec_t *iov,
+                                         uint32_t iovcnt, uint32_t data_address)
+{
+    TRACE_PRINTF("%s(0x%p, %lu, 0x%lx)\n", __func__, iov, iovcnt, data_address);
+    if (NULL == sd_card_p)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (sd_card_p->state.m_Status & (STA_NOINIT | STA_NODISK))
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    uint32_t num_wrt_blks = sd_iov_blocks(iov, iovcnt);
+    if (!num_wrt_blks) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (data_address + num_wrt_blks >= sd_card_p->state.sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+
+    sd_acquire(sd_card_p);
+
+    block_dev_err_t status = SD_BLOCK_DEVICE_ERROR_NONE;
+    if (1 == num_wrt_blks && !SD_SPI_WR_COALESCE_MS) {
+        for (; !iov->count; ++iov);
+        status = write_block(sd_card_p, iov->buffer, data_address);
+    } else {
+        for (uint32_t i = 0; SD_BLOCK_DEVICE_ERROR_NONE == status && i < iovcnt; ++i) {
+            if (!iov[i].count) continue;
+            num_wrt_blks -= iov[i].count;
+            status = sd_write_blocks_retry(sd_card_p, iov[i].buffer, data_address, iov[i].count,
+                                           num_wrt_blks);
+            data_address += iov[i].count;
+        }
+    }
+
+    sd_release(sd_card_p);
+
+    return status;
+}
+
 /**
  * @brief Synchronize the SD card
  *
@@ -1302,10 +1750,351 @@ static block_dev_err_t sd_sync(sd_card_t *sd_card_p) {
     sd_acquire(sd_card_p);
     // Stop any ongoing transmission
     if (sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt) status = stop_wr_tran(sd_card_p);
+    // Data isn't safe until the card has finished programming it
+    if (sd_card_p->spi_if_p->state.card_busy &&
+        false == sd_wait_ready(sd_card_p, sd_timeouts.sd_command))
+        status = SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     sd_release(sd_card_p);
     return status;
 }
 
+/* Asynchronous transfers
+
+These follow the same command sequences as sd_read_blocks and sd_write_blocks,
+but each call to sd_spi_poll_async advances the transfer by at most one step
+(one token poll, one DMA completion, or one busy poll) instead of spinning.
+Unlike the synchronous functions, they do not retry on error.
+A request waits for its turn with the SPI without blocking, and, like the
+synchronous functions, gives the SPI up between blocks after
+SD_SPI_MAX_HOLD_MS if another card is waiting for it, then waits for its
+next turn and resumes with a new command.
+*/
+typedef enum {
+    SPI_ASYNC_BUS_WAIT,  // Waiting for a turn with the SPI
+    SPI_ASYNC_RD_TOKEN,  // Waiting for the Start Block token
+    SPI_ASYNC_RD_DATA,   // DMA is receiving the block data
+    SPI_ASYNC_WR_DATA,   // DMA is sending the block data
+    SPI_ASYNC_WR_BUSY    // Card is busy programming
+} spi_async_phase_t;
+
+static block_dev_err_t sd_spi_async_end(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                        block_dev_err_t status) {
+    sd_release(sd_card_p);
+    sd_async_complete(req_p, status);
+    return status;
+}
+// Fails a request that doesn't have the SPI
+static block_dev_err_t sd_spi_async_reject(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                           block_dev_err_t status) {
+    sd_unlock(sd_card_p);
+    sd_async_complete(req_p, status);
+    return status;
+}
+// Joins the queue for the SPI. The request is resumed when its turn comes.
+static void sd_spi_async_enqueue(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    req_p->ticket = sd_spi_take_ticket(sd_card_p);
+    req_p->phase = SPI_ASYNC_BUS_WAIT;
+}
+// Lets the cards waiting for the SPI have their turns. The transfer must be stopped.
+static void sd_spi_async_yield(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    sd_spi_release(sd_card_p);
+    sd_spi_async_enqueue(sd_card_p, req_p);
+}
+static bool sd_spi_poll_async(sd_card_t *sd_card_p, sd_async_req_t *req_p);
+
+// Wait for the DMA to finish (or give up on it, if it has timed out)
+static bool sd_spi_async_dma_done(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    uint32_t timeout = calculate_transfer_time_ms(sd_card_p->spi_if_p->spi, sd_block_size);
+    if (millis() - req_p->start_time >= timeout) timeout = 0;
+    return sd_spi_transfer_wait_complete(sd_card_p, timeout);
+}
+
+static block_dev_err_t sd_spi_read_blocks_async(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                                uint8_t *buffer, uint32_t data_address,
+                                                uint32_t num_rd_blks) {
+    TRACE_PRINTF("%s(0x%p, 0x%lx, 0x%lx)\n", __func__, buffer, data_address, num_rd_blks);
+    sd_lock(sd_card_p);
+    sd_finish_deferred_check(sd_card_p);
+    sd_async_start(sd_card_p, req_p, false, data_address, num_rd_blks);
+    req_p->rd_buf = buffer;
+
+    if (sd_card_p->state.m_Status & (STA_NOINIT | STA_NODISK) || !num_rd_blks ||
+        data_address + num_rd_blks > sd_card_p->state.sectors)
+        return sd_spi_async_reject(sd_card_p, req_p, SD_BLOCK_DEVICE_ERROR_PARAMETER);
+
+    sd_spi_async_enqueue(sd_card_p, req_p);
+    // If the SPI is free, send the command now
+    if (sd_spi_poll_async(sd_card_p, req_p)) return SD_BLOCK_DEVICE_ERROR_NONE;
+    return req_p->result;
+}
+
+// Send the command for the rest of a read, on the request's turn with the SPI
+static block_dev_err_t sd_spi_async_begin_rd(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    uint32_t data_address = req_p->sector + req_p->blocks_done;
+    block_dev_err_t status = SD_BLOCK_DEVICE_ERROR_NONE;
+
+    // Stop any ongoing write transmission
+    if (sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt) status = stop_wr_tran(sd_card_p);
+
+    /* Send command to receive data.
+    A read that is resumed after yielding the SPI has a count > 1,
+    so it is stopped with CMD12 all the same. */
+    if (SD_BLOCK_DEVICE_ERROR_NONE == status) {
+        if (req_p->count == 1)
+            status = sd_cmd(sd_card_p, CMD17_READ_SINGLE_BLOCK, data_address, false, 0);
+        else
+            status = sd_cmd(sd_card_p, CMD18_READ_MULTIPLE_BLOCK, data_address, false, 0);
+    }
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
+
+    req_p->phase = SPI_ASYNC_RD_TOKEN;
+    req_p->start_time = millis();
+    return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+}
+
+static block_dev_err_t sd_spi_poll_rd(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    switch (req_p->phase) {
+        case SPI_ASYNC_BUS_WAIT:
+            if (!sd_spi_try_acquire(sd_card_p, req_p->ticket))
+                return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+            return sd_spi_async_begin_rd(sd_card_p, req_p);
+        case SPI_ASYNC_RD_TOKEN: {
+            uint8_t *buffer = req_p->rd_buf + req_p->blocks_done * sd_block_size;
+            int received = sd_scan_token(sd_card_p, buffer);
+            if (SD_TOKEN_ERROR == received) return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+            if (SD_TOKEN_NONE != received) {
+                req_p->sniffed = sd_read_block_start(sd_card_p, buffer, received);
+                req_p->phase = SPI_ASYNC_RD_DATA;
+                req_p->start_time = millis();
+            } else if (millis() - req_p->start_time >= sd_timeouts.sd_command) {
+                DBG_PRINTF("%s:%d Read timeout\n", __func__, __LINE__);
+                return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+            }
+            return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+        }
+        case SPI_ASYNC_RD_DATA: {
+            // While the DMA is busy, check the CRC for the previous block
+            if (req_p->prev_buf) {
+                if (!chk_data_crc16(sd_card_p, req_p->prev_buf, req_p->prev_crc))
+                    return SD_BLOCK_DEVICE_ERROR_CRC;
+                req_p->prev_buf = NULL;
+            }
+            if (sd_spi_transfer_is_busy(sd_card_p) &&
+                millis() - req_p->start_time <
+                    calculate_transfer_time_ms(sd_card_p->spi_if_p->spi, sd_block_size))
+                return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+            if (!sd_spi_async_dma_done(sd_card_p, req_p)) return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+            uint16_t sniffed_crc = req_p->sniffed ? sd_spi_get_crc16(sd_card_p) : 0;
+
+            // Read the CRC16 checksum for the data block
+            req_p->prev_crc = sd_spi_read(sd_card_p) << 8;
+            req_p->prev_crc |= sd_spi_read(sd_card_p);
+            req_p->prev_buf = req_p->rd_buf + req_p->blocks_done * sd_block_size;
+            if (req_p->sniffed) {
+                // Nothing left to compute
+                if (!chk_sniffed_crc16(sd_card_p, req_p->prev_crc, sniffed_crc))
+                    return SD_BLOCK_DEVICE_ERROR_CRC;
+                req_p->prev_buf = NULL;
+            }
+            if (++req_p->blocks_done < req_p->count) {
+                if (sd_spi_should_yield(sd_card_p)) {
+                    // Stop, and let the cards waiting for the SPI have their turns
+                    block_dev_err_t status =
+                        sd_cmd(sd_card_p, CMD12_STOP_TRANSMISSION, 0x0, false, 0);
+                    if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
+                    if (req_p->prev_buf &&
+                        !chk_data_crc16(sd_card_p, req_p->prev_buf, req_p->prev_crc))
+                        return SD_BLOCK_DEVICE_ERROR_CRC;
+                    req_p->prev_buf = NULL;
+                    sd_spi_async_yield(sd_card_p, req_p);
+                    return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+                }
+                req_p->phase = SPI_ASYNC_RD_TOKEN;
+                req_p->start_time = millis();
+                return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+            }
+            block_dev_err_t status = SD_BLOCK_DEVICE_ERROR_NONE;
+            if (req_p->count > 1) {
+                // Send CMD12(0x00000000) to stop the transmission for multi-block transfer
+                status = sd_cmd(sd_card_p, CMD12_STOP_TRANSMISSION, 0x0, false, 0);
+                if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
+            }
+            // Check final block's CRC:
+            if (req_p->prev_buf && !chk_data_crc16(sd_card_p, req_p->prev_buf, req_p->prev_crc))
+                return SD_BLOCK_DEVICE_ERROR_CRC;
+            return status;
+        }
+        default:
+            myASSERT(false);
+            return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    }
+}
+
+// Start sending the next block of an asynchronous write
+static block_dev_err_t sd_spi_async_send_block(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    const uint8_t *buffer = req_p->wr_buf + req_p->blocks_done * sd_block_size;
+    uint8_t token = 1 == req_p->count ? SPI_START_BLOCK : SPI_START_BLK_MUL_WRITE;
+
+    // Only a continued write can find the card still busy
+    if (sd_card_p->spi_if_p->state.card_busy &&
+        false == sd_wait_ready(sd_card_p, sd_timeouts.sd_command)) {
+        DBG_PRINTF("%s:%d: Card not ready yet\n", __func__, __LINE__);
+        return SD_BLOCK_DEVICE_ERROR_WRITE;
+    }
+
+    /* Indicate start of block - Start Block Token */
+    uint8_t response = sd_spi_write_read(sd_card_p, token);
+    if (!response) {
+        DBG_PRINTF("Start Block Token not accepted. Response: 0x%x\n", response);
+        return SD_BLOCK_DEVICE_ERROR_WRITE;
+    }
+    // Write the data
+    req_p->sniffed = sd_write_block_start(sd_card_p, buffer, sd_block_size);
+    req_p->phase = SPI_ASYNC_WR_DATA;
+    req_p->start_time = millis();
+
+    // While DMA transfers the block, compute CRC, unless the sniffer does:
+    if (!req_p->sniffed) req_p->prev_crc = block_crc16(buffer, sd_block_size);
+
+    return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+}
+
+static block_dev_err_t sd_spi_write_blocks_async(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                                 uint8_t const buffer[], uint32_t data_address,
+                                                 uint32_t num_wrt_blks) {
+    TRACE_PRINTF("%s(0x%p, 0x%lx, 0x%lx)\n", __func__, buffer, data_address, num_wrt_blks);
+    sd_lock(sd_card_p);
+    sd_finish_deferred_check(sd_card_p);
+    sd_async_start(sd_card_p, req_p, true, data_address, num_wrt_blks);
+    req_p->wr_buf = buffer;
+
+    if (sd_card_p->state.m_Status & (STA_NOINIT | STA_NODISK) || !num_wrt_blks ||
+        data_address + num_wrt_blks >= sd_card_p->state.sectors)
+        return sd_spi_async_reject(sd_card_p, req_p, SD_BLOCK_DEVICE_ERROR_PARAMETER);
+
+    sd_spi_async_enqueue(sd_card_p, req_p);
+    // If the SPI is free, send the command and start the first block now
+    if (sd_spi_poll_async(sd_card_p, req_p)) return SD_BLOCK_DEVICE_ERROR_NONE;
+    return req_p->result;
+}
+
+// Send the command for the rest of a write, on the request's turn with the SPI
+static block_dev_err_t sd_spi_async_begin_wr(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    uint32_t data_address = req_p->sector + req_p->blocks_done;
+    uint32_t num_wrt_blks = req_p->count - req_p->blocks_done;
+    sd_spi_if_state_t *state_p = &sd_card_p->spi_if_p->state;
+    block_dev_err_t status = SD_BLOCK_DEVICE_ERROR_NONE;
+    if (1 < req_p->count && sd_wr_continues(sd_card_p, data_address, num_wrt_blks)) {
+        /* Continue a multiblock write */
+        state_p->n_wrt_blks_reqd += num_wrt_blks;
+    } else {
+        // Stop any ongoing write transmission
+        if (state_p->ongoing_mlt_blk_wrt) status = stop_wr_tran(sd_card_p);
+        if (SD_BLOCK_DEVICE_ERROR_NONE == status) {
+            // A write that is resumed after yielding the SPI has a count > 1
+            if (1 == req_p->count) {
+                state_p->blk_cnt_set = false;
+                status = sd_cmd(sd_card_p, CMD24_WRITE_BLOCK, data_address, false, 0);
+            } else {
+                sd_wr_declare_count(sd_card_p, num_wrt_blks);
+                status = sd_cmd(sd_card_p, CMD25_WRITE_MULTIPLE_BLOCK, data_address, false, 0);
+                state_p->n_wrt_blks_reqd = num_wrt_blks;
+            }
+        }
+    }
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
+    return sd_spi_async_send_block(sd_card_p, req_p);
+}
+
+static block_dev_err_t sd_spi_poll_wr(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    switch (req_p->phase) {
+        case SPI_ASYNC_BUS_WAIT:
+            if (!sd_spi_try_acquire(sd_card_p, req_p->ticket))
+                return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+            return sd_spi_async_begin_wr(sd_card_p, req_p);
+        case SPI_ASYNC_WR_DATA: {
+            if (sd_spi_transfer_is_busy(sd_card_p) &&
+                millis() - req_p->start_time <
+                    calculate_transfer_time_ms(sd_card_p->spi_if_p->spi, sd_block_size))
+                return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+            if (!sd_spi_async_dma_done(sd_card_p, req_p)) return SD_BLOCK_DEVICE_ERROR_WRITE;
+            if (req_p->sniffed) req_p->prev_crc = sd_spi_get_crc16(sd_card_p);
+
+            // Write the checksum CRC16
+            sd_spi_write(sd_card_p, req_p->prev_crc >> 8);
+            sd_spi_write(sd_card_p, req_p->prev_crc);
+
+            // Check the response token
+            uint8_t response = sd_spi_read(sd_card_p);
+            if ((response & SPI_DATA_RESPONSE_MASK) != SPI_DATA_ACCEPTED) {
+                EMSG_PRINTF("%s: Block Write not accepted. Response token: 0x%x\n",
+                            sd_get_drive_prefix(sd_card_p), response);
+                return SD_BLOCK_DEVICE_ERROR_WRITE;
+            }
+            sd_card_p->spi_if_p->state.card_busy = true;
+            if (1 < req_p->count && req_p->blocks_done + 1 == req_p->count) {
+                // The last block of a multiple block write: leave the card programming
+                req_p->blocks_done++;
+                // With CMD23, the card ends the write after the declared number of blocks
+                if (!sd_card_p->spi_if_p->state.blk_cnt_set) {
+                    sd_card_p->spi_if_p->state.cont_sector_wrt = req_p->sector + req_p->count;
+                    sd_card_p->spi_if_p->state.wr_run_time = millis();
+                    sd_card_p->spi_if_p->state.ongoing_mlt_blk_wrt = true;
+                }
+                return SD_BLOCK_DEVICE_ERROR_NONE;
+            }
+            req_p->phase = SPI_ASYNC_WR_BUSY;
+            req_p->start_time = millis();
+            return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+        }
+        case SPI_ASYNC_WR_BUSY:
+            // Wait while card is busy programming
+            if (sd_busy_poll(sd_card_p)) {
+                if (millis() - req_p->start_time < sd_timeouts.sd_command)
+                    return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+                DBG_PRINTF("%s:%d: Card not ready yet\n", __func__, __LINE__);
+                return SD_BLOCK_DEVICE_ERROR_WRITE;
+            }
+            sd_card_p->spi_if_p->state.card_busy = false;
+            if (++req_p->blocks_done < req_p->count) {
+                if (sd_spi_should_yield(sd_card_p)) {
+                    // Close the write, and let the cards waiting for the SPI have their turns
+                    block_dev_err_t status = stop_wr_tran(sd_card_p);
+                    if (SD_BLOCK_DEVICE_ERROR_NONE != status) return status;
+                    sd_spi_async_yield(sd_card_p, req_p);
+                    return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+                }
+                return sd_spi_async_send_block(sd_card_p, req_p);
+            }
+            // Send command to get the status of the card
+            uint32_t stat = 0;
+            return sd_cmd(sd_card_p, CMD13_SEND_STATUS, 0, false, &stat);
+        default:
+            myASSERT(false);
+            return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    }
+}
+
+static bool sd_spi_poll_async(sd_card_t *sd_card_p, sd_async_req_t *req_p) {
+    block_dev_err_t status;
+    if (req_p->write)
+        status = sd_spi_poll_wr(sd_card_p, req_p);
+    else
+        status = sd_spi_poll_rd(sd_card_p, req_p);
+    if (SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK == status) return true;
+
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status) {
+        if (sd_spi_transfer_is_busy(sd_card_p)) sd_spi_transfer_wait_complete(sd_card_p, 0);
+        if (req_p->write) {
+            if (1 < req_p->count) stop_wr_tran(sd_card_p);  // Ignore return value
+        } else if (1 < req_p->count) {
+            sd_cmd(sd_card_p, CMD12_STOP_TRANSMISSION, 0x0, false, 0);  // Ignore return value
+        }
+    }
+    sd_spi_async_end(sd_card_p, req_p, status);
+    return false;
+}
+
 /*!< Number of retries for sending CMDO */
 #define SD_CMD0_GO_IDLE_STATE_RETRIES 10
 
@@ -1578,6 +2367,31 @@ static bool sd_spi_test_com(sd_card_t *sd_card_p) {
     return success;
 }
 
+// Clock training probe: read the CSD
+static bool sd_spi_clk_probe(sd_card_t *sd_card_p) {
+    sd_spi_sync_frequency(sd_card_p);
+    return 0 != in_sd_spi_sectors(sd_card_p);
+}
+
+// Read the SD Configuration Register (ACMD51) and note whether the card supports CMD23
+static bool sd_spi_read_scr(sd_card_t *sd_card_p) {
+    sd_card_p->state.cmd23_supported = false;
+    // ACMD23 is mandatory for SD memory cards, but try it before relying on it
+    sd_card_p->state.pre_erase_supported = true;
+    if (SD_BLOCK_DEVICE_ERROR_NONE != sd_cmd(sd_card_p, ACMD51_SEND_SCR, 0, true, 0)) {
+        DBG_PRINTF("ACMD51 failed\n");
+        return false;
+    }
+    if (SD_BLOCK_DEVICE_ERROR_NONE !=
+        read_bytes(sd_card_p, sd_card_p->state.SCR, sizeof(SCR_t))) {
+        DBG_PRINTF("Couldn't read SCR\n");
+        return false;
+    }
+    sd_card_p->state.cmd23_supported =
+        ext_bits(sizeof(SCR_t), sd_card_p->state.SCR, 33, 33);
+    return true;
+}
+
 /**
  * @brief Initializes the SD card over SPI.
  *
@@ -1616,6 +2430,9 @@ DSTATUS sd_card_spi_init(sd_card_t *sd_card_p) {
 
     // Initialize the member variables
     sd_card_p->state.card_type = SDCARD_NONE;
+    sd_card_p->spi_if_p->state.deferred_buf = NULL;
+    sd_card_p->spi_if_p->state.card_busy = false;
+    sd_clk_init(sd_card_p, 0);
 
     // Acquire the SD card
     sd_spi_acquire(sd_card_p);
@@ -1637,8 +2454,12 @@ DSTATUS sd_card_spi_init(sd_card_t *sd_card_p) {
     DBG_PRINTF("SD card initialized\n");
 
     // Set SCK for data transfer
+    sd_clk_init(sd_card_p, sd_card_p->spi_if_p->spi->baud_rate);
     sd_spi_go_high_frequency(sd_card_p);
 
+    // Find the highest clock this board can run reliably
+    sd_clk_train(sd_card_p, sd_spi_clk_probe);
+
     // Get the number of sectors on the card
     sd_card_p->state.sectors = in_sd_spi_sectors(sd_card_p);
     if (0 == sd_card_p->state.sectors) {
@@ -1666,6 +2487,9 @@ DSTATUS sd_card_spi_init(sd_card_t *sd_card_p) {
         return sd_card_p->state.m_Status;
     }
 
+    // Not fatal: without the SCR, multiple block transfers are open-ended
+    sd_spi_read_scr(sd_card_p);
+
     // The card is now initialized
     sd_card_p->state.m_Status &= ~STA_NOINIT;
 
@@ -1709,6 +2533,11 @@ static void sd_deinit(sd_card_t *sd_card_p) {
 void sd_spi_ctor(sd_card_t *sd_card_p) {
     sd_card_p->write_blocks = sd_write_blocks;
     sd_card_p->read_blocks = sd_read_blocks;
+    sd_card_p->write_blocks_v = sd_write_blocks_v;
+    sd_card_p->read_blocks_v = sd_read_blocks_v;
+    sd_card_p->write_blocks_async = sd_spi_write_blocks_async;
+    sd_card_p->read_blocks_async = sd_spi_read_blocks_async;
+    sd_card_p->poll_async = sd_spi_poll_async;
     sd_card_p->sync = sd_sync;
     sd_card_p->init = sd_card_spi_init;
     sd_card_p->deinit = sd_deinit;
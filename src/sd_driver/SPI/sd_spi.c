@@ -33,11 +33,21 @@ specific language governing permissions and limitations under the License.
 // #define TRACE_PRINTF printf
 
 void sd_spi_go_high_frequency(sd_card_t *sd_card_p) {
-    uint actual = spi_set_baudrate(sd_card_p->spi_if_p->spi->hw_inst, sd_card_p->spi_if_p->spi->baud_rate);
+    sd_clk_stats_t *clk_p = &sd_card_p->state.clk;
+    uint baud_rate = clk_p->max_hz ? clk_p->clk_hz : sd_card_p->spi_if_p->spi->baud_rate;
+    uint actual = my_spi_set_baudrate(sd_card_p->spi_if_p->spi, baud_rate);
+    if (clk_p->max_hz) clk_p->actual_hz = actual;
     DBG_PRINTF("%s: Actual frequency: %lu\n", __FUNCTION__, (long)actual);
 }
+// Cards that share a bus can run at different clocks.
+// Also applies changes made by the adaptive bus clock.
+void sd_spi_sync_frequency(sd_card_t *sd_card_p) {
+    const sd_clk_stats_t *clk_p = &sd_card_p->state.clk;
+    if (clk_p->max_hz && my_spi_get_baudrate(sd_card_p->spi_if_p->spi) != clk_p->actual_hz)
+        sd_spi_go_high_frequency(sd_card_p);
+}
 void sd_spi_go_low_frequency(sd_card_t *sd_card_p) {
-    uint actual = spi_set_baudrate(sd_card_p->spi_if_p->spi->hw_inst, 400 * 1000); // Actual frequency: 398089
+    uint actual = my_spi_set_baudrate(sd_card_p->spi_if_p->spi, 400 * 1000); // Actual frequency: 398089
     DBG_PRINTF("%s: Actual frequency: %lu\n", __FUNCTION__, (long)actual);
 }
 
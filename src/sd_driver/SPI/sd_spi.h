@@ -21,6 +21,7 @@ specific language governing permissions and limitations under the License.
 #include "delays.h"
 #include "my_debug.h"
 #include "my_spi.h"
+#include "pio_spi.h"
 #include "sd_card.h"
 #include "sd_timeouts.h"
 
@@ -34,6 +35,7 @@ extern "C" {
 
 void sd_spi_go_low_frequency(sd_card_t *this);
 void sd_spi_go_high_frequency(sd_card_t *this);
+void sd_spi_sync_frequency(sd_card_t *this);
 
 /* 
 After power up, the host starts the clock and sends the initializing sequence on the CMD line. 
@@ -48,6 +50,11 @@ void sd_spi_send_initializing_sequence(sd_card_t *sd_card_p);
 
 static inline uint8_t sd_spi_read(sd_card_t *sd_card_p) {
     uint8_t received = SPI_FILL_CHAR;
+    if (sd_card_p->spi_if_p->spi->pio) {
+        // Nothing received reads as an idle bus
+        pio_spi_write_read(sd_card_p->spi_if_p->spi, SPI_FILL_CHAR, &received);
+        return received;
+    }
     uint32_t start = millis();
     while (!spi_is_writable(sd_card_p->spi_if_p->spi->hw_inst) &&
            millis() - start < sd_timeouts.sd_spi_read)
@@ -59,6 +66,12 @@ static inline uint8_t sd_spi_read(sd_card_t *sd_card_p) {
 }
 
 static inline void sd_spi_write(sd_card_t *sd_card_p, const uint8_t value) {
+    if (sd_card_p->spi_if_p->spi->pio) {
+        // The received byte must still be taken from the RX FIFO
+        uint8_t received;
+        pio_spi_write_read(sd_card_p->spi_if_p->spi, value, &received);
+        return;
+    }
     uint32_t start = millis();
     while (!spi_is_writable(sd_card_p->spi_if_p->spi->hw_inst) &&
            millis() - start < sd_timeouts.sd_spi_write)
@@ -69,6 +82,10 @@ static inline void sd_spi_write(sd_card_t *sd_card_p, const uint8_t value) {
 }
 static inline uint8_t sd_spi_write_read(sd_card_t *sd_card_p, const uint8_t value) {
     uint8_t received = SPI_FILL_CHAR;
+    if (sd_card_p->spi_if_p->spi->pio) {
+        pio_spi_write_read(sd_card_p->spi_if_p->spi, value, &received);
+        return received;
+    }
     uint32_t start = millis();
     while (!spi_is_writable(sd_card_p->spi_if_p->spi->hw_inst) &&
            millis() - start < sd_timeouts.sd_spi_write_read)
@@ -107,12 +124,30 @@ static inline void sd_spi_unlock(sd_card_t *sd_card_p) { spi_unlock(sd_card_p->s
 
 static inline void sd_spi_acquire(sd_card_t *sd_card_p) {
     sd_spi_lock(sd_card_p);
+    sd_spi_sync_frequency(sd_card_p);
     sd_spi_select(sd_card_p);
 }
 static inline void sd_spi_release(sd_card_t *sd_card_p) {
     sd_spi_deselect(sd_card_p);
     sd_spi_unlock(sd_card_p);
 }
+// For asynchronous requests: join the queue for the SPI without waiting
+static inline uint32_t sd_spi_take_ticket(sd_card_t *sd_card_p) {
+    return spi_take_ticket(sd_card_p->spi_if_p->spi);
+}
+// Then, acquire the SPI if it is the ticket's turn
+static inline bool sd_spi_try_acquire(sd_card_t *sd_card_p, uint32_t ticket) {
+    if (!spi_try_turn(sd_card_p->spi_if_p->spi, ticket)) return false;
+    sd_spi_sync_frequency(sd_card_p);
+    sd_spi_select(sd_card_p);
+    return true;
+}
+static inline bool sd_spi_has_waiters(sd_card_t *sd_card_p) {
+    return spi_has_waiters(sd_card_p->spi_if_p->spi);
+}
+static inline bool sd_spi_should_yield(sd_card_t *sd_card_p) {
+    return spi_should_yield(sd_card_p->spi_if_p->spi);
+}
 
 static inline void sd_spi_transfer_start(sd_card_t *sd_card_p, const uint8_t *tx, uint8_t *rx,
                                          size_t length) {
@@ -121,6 +156,16 @@ static inline void sd_spi_transfer_start(sd_card_t *sd_card_p, const uint8_t *tx
 static inline bool sd_spi_transfer_wait_complete(sd_card_t *sd_card_p, uint32_t timeout_ms) {
     return spi_transfer_wait_complete(sd_card_p->spi_if_p->spi, timeout_ms);
 }
+static inline bool sd_spi_transfer_start_crc16(sd_card_t *sd_card_p, const uint8_t *tx,
+                                               uint8_t *rx, size_t length, uint16_t seed) {
+    return spi_transfer_start_crc16(sd_card_p->spi_if_p->spi, tx, rx, length, seed);
+}
+static inline uint16_t sd_spi_get_crc16(sd_card_t *sd_card_p) {
+    return spi_get_crc16(sd_card_p->spi_if_p->spi);
+}
+static inline bool sd_spi_transfer_is_busy(sd_card_t *sd_card_p) {
+    return spi_transfer_is_busy(sd_card_p->spi_if_p->spi);
+}
 /* Transfer tx to SPI while receiving SPI to rx. 
 tx or rx can be NULL if not important. */
 static inline bool sd_spi_transfer(sd_card_t *sd_card_p, const uint8_t *tx, uint8_t *rx,
@@ -4,31 +4,50 @@
 //
 #include "dma_interrupts.h"
 
-static void dma_irq_handler(const uint DMA_IRQ_num, io_rw_32 *dma_hw_ints_p) {
-    // Iterate through all of the SD cards
-    for (size_t i = 0; i < sd_get_num(); ++i) {
-        sd_card_t *sd_card_p = sd_get_by_num(i);
-        if (!sd_card_p)
-            continue;
-        uint irq_num = 0, channel = 0;
-        if (SD_IF_SDIO == sd_card_p->type) {
-            irq_num = sd_card_p->sdio_if_p->DMA_IRQ_num;
-            channel = sd_card_p->sdio_if_p->state.SDIO_DMA_CHB;
-        }
-        // Is this channel requesting interrupt?
-        if (irq_num == DMA_IRQ_num && (*dma_hw_ints_p & (1 << channel))) {
-            *dma_hw_ints_p = 1 << channel;  // Clear it.
-            if (SD_IF_SDIO == sd_card_p->type) {
-                sdio_irq_handler(sd_card_p);
-            }
-        }
+/* Interrupt routing
+Each DMA channel that raises interrupts for an SD card has an entry here,
+filled in by dma_irq_add_handler. The IRQ handler goes straight from the
+pending channels to their handlers, so its cost doesn't grow with the
+number of cards. */
+typedef struct dma_irq_route_t {
+    dma_irq_channel_handler_t handler;
+    sd_card_t *sd_card_p;
+    dma_irq_stats_t stats;
+} dma_irq_route_t;
+static dma_irq_route_t routes[NUM_DMA_CHANNELS];
+
+// Channels routed through DMA_IRQ_0 and DMA_IRQ_1
+static uint32_t irq_channels[2];
+
+static void dma_irq_handler(const uint32_t channels, io_rw_32 *dma_hw_ints_p) {
+    // Are these channels requesting interrupt?
+    uint32_t ints = *dma_hw_ints_p & channels;
+    *dma_hw_ints_p = ints;  // Clear them.
+    while (ints) {
+        uint ch = __builtin_ctz(ints);
+        ints &= ints - 1;
+        dma_irq_route_t *route_p = &routes[ch];
+        uint32_t start = time_us_32();
+        route_p->handler(route_p->sd_card_p);
+        uint32_t elapsed = time_us_32() - start;
+        route_p->stats.count++;
+        if (elapsed > route_p->stats.max_us) route_p->stats.max_us = elapsed;
     }
 }
 static void __not_in_flash_func(dma_irq_handler_0)() {
-    dma_irq_handler(DMA_IRQ_0, &dma_hw->ints0);
+    dma_irq_handler(irq_channels[0], &dma_hw->ints0);
 }
 static void __not_in_flash_func(dma_irq_handler_1)() {
-    dma_irq_handler(DMA_IRQ_1, &dma_hw->ints1);
+    dma_irq_handler(irq_channels[1], &dma_hw->ints1);
+}
+
+void dma_irq_get_stats(uint channel, dma_irq_stats_t *stats_p) {
+    myASSERT(channel < NUM_DMA_CHANNELS);
+    *stats_p = routes[channel].stats;
+}
+void dma_irq_reset_stats(void) {
+    for (size_t i = 0; i < count_of(routes); ++i)
+        routes[i].stats = (dma_irq_stats_t){0};
 }
 
 /* Adding the interrupt request handler 
@@ -59,7 +78,17 @@ static void mark_handler_added(const uint num) {
         }
     myASSERT(i < count_of(ih_added_recs));
 }
-void dma_irq_add_handler(const uint num, bool exclusive) {
+void dma_irq_add_handler(const uint num, bool exclusive, uint32_t channel_mask,
+                         dma_irq_channel_handler_t handler, sd_card_t *sd_card_p) {
+    myASSERT(DMA_IRQ_0 == num || DMA_IRQ_1 == num);
+    for (uint ch = 0; ch < NUM_DMA_CHANNELS; ++ch) {
+        if (channel_mask & (1u << ch)) {
+            routes[ch].handler = handler;
+            routes[ch].sd_card_p = sd_card_p;
+        }
+    }
+    irq_channels[DMA_IRQ_1 == num] |= channel_mask;
+
     if (!is_handler_added(num)) {        
         static void (*irq_handler)();
         switch (num) {
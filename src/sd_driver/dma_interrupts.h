@@ -7,7 +7,22 @@
 extern "C" {
 #endif
 
-void dma_irq_add_handler(const uint num, bool exclusive);
+typedef struct sd_card_t sd_card_t;
+
+typedef void (*dma_irq_channel_handler_t)(sd_card_t *sd_card_p);
+
+typedef struct dma_irq_stats_t {
+    uint32_t count;   // Number of interrupts handled
+    uint32_t max_us;  // Worst case time spent in the channel's handler
+} dma_irq_stats_t;
+
+/* Route the interrupts of the DMA channels in channel_mask to handler(sd_card_p),
+and install the handler of DMA_IRQ num if it isn't installed yet. */
+void dma_irq_add_handler(const uint num, bool exclusive, uint32_t channel_mask,
+                         dma_irq_channel_handler_t handler, sd_card_t *sd_card_p);
+
+void dma_irq_get_stats(uint channel, dma_irq_stats_t *stats_p);
+void dma_irq_reset_stats(void);
 
 #ifdef __cplusplus
 }
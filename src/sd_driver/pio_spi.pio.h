@@ -0,0 +1,42 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+#define PIO_SPI_CYCLES_PER_BIT 4
+
+// ------- //
+// pio_spi //
+// ------- //
+
+#define pio_spi_wrap_target 0
+#define pio_spi_wrap 2
+
+static const uint16_t pio_spi_program_instructions[] = {
+            //     .wrap_target
+    0x6101, //  0: out    pins, 1         side 0 [1] 
+    0xb042, //  1: nop                    side 1     
+    0x5001, //  2: in     pins, 1         side 1     
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program pio_spi_program = {
+    .instructions = pio_spi_program_instructions,
+    .length = 3,
+    .origin = -1,
+};
+
+static inline pio_sm_config pio_spi_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + pio_spi_wrap_target, offset + pio_spi_wrap);
+    sm_config_set_sideset(&c, 1, false, false);
+    return c;
+}
+#endif
+
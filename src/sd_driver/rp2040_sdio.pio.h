@@ -91,27 +91,31 @@ static inline pio_sm_config sdio_data_rx_program_get_default_config(uint offset)
 // sdio_data_tx //
 // ------------ //
 
-#define sdio_data_tx_wrap_target 5
-#define sdio_data_tx_wrap 8
+#define sdio_data_tx_wrap_target 0
+#define sdio_data_tx_wrap 12
 
 static const uint16_t sdio_data_tx_program_instructions[] = {
-    0x203e, //  0: wait   0 pin, 30                  
-    0x24be, //  1: wait   1 pin, 30              [4] 
-    0x6104, //  2: out    pins, 4                [1] 
-    0x0142, //  3: jmp    x--, 2                 [1] 
-    0xe180, //  4: set    pindirs, 0             [1] 
             //     .wrap_target
-    0x4101, //  5: in     pins, 1                [1] 
-    0x0185, //  6: jmp    y--, 5                 [1] 
-    0x21a0, //  7: wait   1 pin, 0               [1] 
-    0x8120, //  8: push   block                  [1] 
+    0x6034, //  0: out    x, 20                      
+    0xe08f, //  1: set    pindirs, 15                
+    0x203e, //  2: wait   0 pin, 30                  
+    0x24be, //  3: wait   1 pin, 30              [4] 
+    0x6104, //  4: out    pins, 4                [1] 
+    0x0144, //  5: jmp    x--, 4                 [1] 
+    0xe10f, //  6: set    pins, 15               [1] 
+    0xe15f, //  7: set    y, 31                  [1] 
+    0xe180, //  8: set    pindirs, 0             [1] 
+    0x4101, //  9: in     pins, 1                [1] 
+    0x0189, // 10: jmp    y--, 9                 [1] 
+    0x8120, // 11: push   block                  [1] 
+    0x21a0, // 12: wait   1 pin, 0               [1] 
             //     .wrap
 };
 
 #if !PICO_NO_HARDWARE
 static const struct pio_program sdio_data_tx_program = {
     .instructions = sdio_data_tx_program_instructions,
-    .length = 9,
+    .length = 13,
     .origin = -1,
 };
 
@@ -21,8 +21,10 @@ specific language governing permissions and limitations under the License.
 //
 #include "pico/mutex.h"
 //
+#include "RAID/sd_card_raid.h"
 #include "SDIO/SdioCard.h"
 #include "SPI/sd_card_spi.h"
+#include "delays.h"
 #include "hw_config.h"  // Hardware Configuration of the SPI and SD Card "objects"
 #include "my_debug.h"
 #include "sd_card_constants.h"
@@ -58,6 +60,210 @@ bool sd_is_locked(sd_card_t *sd_card_p) {
     return !mutex_try_enter(&sd_card_p->state.mutex, &owner_out);
 }
 
+/* Asynchronous requests
+The interface driver calls sd_async_start() when it begins a request
+(with the card locked), and sd_async_complete() when it finishes
+(after unlocking the card). */
+void sd_async_start(sd_card_t *sd_card_p, sd_async_req_t *req_p, bool write, uint32_t sector,
+                    uint32_t count) {
+    myASSERT(req_p);
+    myASSERT(SD_ASYNC_BUSY != req_p->status);
+    req_p->sd_card_p = sd_card_p;
+    req_p->write = write;
+    req_p->sector = sector;
+    req_p->count = count;
+    req_p->blocks_done = 0;
+    req_p->start_time = millis();
+    req_p->phase = 0;
+    req_p->prev_buf = NULL;
+    req_p->prev_crc = 0;
+    req_p->result = SD_BLOCK_DEVICE_ERROR_NONE;
+    req_p->status = SD_ASYNC_BUSY;
+}
+void sd_async_complete(sd_async_req_t *req_p, block_dev_err_t result) {
+    req_p->result = result;
+    req_p->status = SD_ASYNC_DONE;
+    if (req_p->callback) req_p->callback(req_p);
+}
+// Returns true while the request is busy
+bool sd_async_poll(sd_async_req_t *req_p) {
+    myASSERT(req_p);
+    if (SD_ASYNC_BUSY != req_p->status) return false;
+    return req_p->sd_card_p->poll_async(req_p->sd_card_p, req_p);
+}
+block_dev_err_t sd_async_wait(sd_async_req_t *req_p) {
+    while (sd_async_poll(req_p)) tight_loop_contents();
+    return req_p->result;
+}
+
+// Returns true if an earlier transfer on the same card is not done
+static bool sd_multi_card_taken(sd_multi_xfer_t xfers[], size_t i) {
+    for (size_t j = 0; j < i; ++j)
+        if (xfers[j].sd_card_p == xfers[i].sd_card_p && SD_ASYNC_DONE != xfers[j].req.status)
+            return true;
+    return false;
+}
+bool sd_multi_poll(sd_multi_xfer_t xfers[], size_t n) {
+    bool busy = false;
+    for (size_t i = 0; i < n; ++i) {
+        sd_multi_xfer_t *xfer_p = &xfers[i];
+        sd_card_t *sd_card_p = xfer_p->sd_card_p;
+        if (SD_ASYNC_IDLE == xfer_p->req.status) {
+            if (sd_multi_card_taken(xfers, i)) {
+                busy = true;
+                continue;
+            }
+            // On failure to start, the request is completed with the error
+            if (xfer_p->write)
+                sd_card_p->write_blocks_async(sd_card_p, &xfer_p->req, xfer_p->buffer,
+                                              xfer_p->sector, xfer_p->count);
+            else
+                sd_card_p->read_blocks_async(sd_card_p, &xfer_p->req, xfer_p->buffer,
+                                             xfer_p->sector, xfer_p->count);
+        }
+        if (sd_async_poll(&xfer_p->req)) busy = true;
+    }
+    return busy;
+}
+block_dev_err_t sd_multi_wait(sd_multi_xfer_t xfers[], size_t n) {
+    while (sd_multi_poll(xfers, n)) tight_loop_contents();
+    for (size_t i = 0; i < n; ++i)
+        if (SD_BLOCK_DEVICE_ERROR_NONE != xfers[i].req.result) return xfers[i].req.result;
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+// Total number of blocks in a vectored request
+uint32_t sd_iov_blocks(const sd_iovec_t *iov, uint32_t iovcnt) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < iovcnt; ++i) n += iov[i].count;
+    return n;
+}
+
+/* Adaptive bus clock
+SD_CLK_ERR_THRESHOLD blocks with CRC errors within SD_CLK_ERR_WINDOW blocks
+step the clock down to SD_CLK_STEP_NUM / SD_CLK_STEP_DEN of its rate, but not
+below SD_CLK_MIN_HZ. SD_CLK_CLEAN_STREAK blocks without errors step it back up.
+During training, every error steps the clock down. */
+#ifndef SD_CLK_ERR_WINDOW
+#define SD_CLK_ERR_WINDOW 64
+#endif
+#ifndef SD_CLK_ERR_THRESHOLD
+#define SD_CLK_ERR_THRESHOLD 2
+#endif
+#ifndef SD_CLK_CLEAN_STREAK
+#define SD_CLK_CLEAN_STREAK 8192
+#endif
+#ifndef SD_CLK_STEP_NUM
+#define SD_CLK_STEP_NUM 3
+#define SD_CLK_STEP_DEN 4
+#endif
+#ifndef SD_CLK_MIN_HZ
+#define SD_CLK_MIN_HZ (1000 * 1000)
+#endif
+#ifndef SD_CLK_TRAIN_READS
+#define SD_CLK_TRAIN_READS 8
+#endif
+
+void sd_clk_init(sd_card_t *sd_card_p, uint32_t max_hz) {
+    sd_clk_stats_t *clk_p = &sd_card_p->state.clk;
+    memset(clk_p, 0, sizeof *clk_p);
+    clk_p->max_hz = max_hz;
+    clk_p->clk_hz = max_hz;
+    clk_p->actual_hz = max_hz;
+}
+bool sd_clk_feedback(sd_card_t *sd_card_p, uint32_t blocks, uint32_t crc_errors) {
+    sd_clk_stats_t *clk_p = &sd_card_p->state.clk;
+    if (!clk_p->max_hz) return false;
+    clk_p->blocks += blocks;
+    clk_p->crc_errors += crc_errors;
+    if (crc_errors) {
+        clk_p->clean_streak = 0;
+        if (!clk_p->window_errors || clk_p->blocks - clk_p->window_start > SD_CLK_ERR_WINDOW) {
+            // Start a new window
+            clk_p->window_start = clk_p->blocks - blocks;
+            clk_p->window_errors = 0;
+        }
+        clk_p->window_errors += crc_errors;
+        if (clk_p->window_errors < SD_CLK_ERR_THRESHOLD && !clk_p->training) return false;
+        clk_p->window_errors = 0;
+        uint32_t clk_hz = (uint64_t)clk_p->clk_hz * SD_CLK_STEP_NUM / SD_CLK_STEP_DEN;
+        if (clk_hz < SD_CLK_MIN_HZ) clk_hz = SD_CLK_MIN_HZ;
+        if (clk_hz >= clk_p->clk_hz) return false;
+        clk_p->clk_hz = clk_hz;
+        clk_p->steps_down++;
+    } else {
+        clk_p->clean_streak += blocks;
+        if (clk_p->clean_streak < SD_CLK_CLEAN_STREAK || clk_p->clk_hz >= clk_p->max_hz)
+            return false;
+        clk_p->clean_streak = 0;
+        uint32_t clk_hz = (uint64_t)clk_p->clk_hz * SD_CLK_STEP_DEN / SD_CLK_STEP_NUM;
+        if (clk_hz > clk_p->max_hz) clk_hz = clk_p->max_hz;
+        clk_p->clk_hz = clk_hz;
+        clk_p->steps_up++;
+    }
+    DBG_PRINTF("%s: %s bus clock %lu Hz\n", sd_get_drive_prefix(sd_card_p),
+               crc_errors ? "Lowering" : "Raising", (unsigned long)clk_p->clk_hz);
+    return true;
+}
+void sd_clk_train(sd_card_t *sd_card_p, bool (*probe)(sd_card_t *sd_card_p)) {
+    sd_clk_stats_t *clk_p = &sd_card_p->state.clk;
+    clk_p->training = true;
+    unsigned clean = 0;
+    while (clean < SD_CLK_TRAIN_READS) {
+        uint32_t crc_errors = clk_p->crc_errors;
+        bool ok = probe(sd_card_p);
+        if (clk_p->crc_errors != crc_errors) {
+            if (clk_p->clk_hz <= SD_CLK_MIN_HZ) break;
+            clean = 0;
+        } else if (ok) {
+            clean++;
+        } else {
+            break;  // Not a signal integrity problem
+        }
+    }
+    clk_p->training = false;
+    DBG_PRINTF("%s: bus clock trained to %lu Hz\n", sd_get_drive_prefix(sd_card_p),
+               (unsigned long)clk_p->clk_hz);
+}
+
+/* Multiple block transfers of known length can be declared with CMD23
+SET_BLOCK_COUNT, if the card supports it (SCR CMD_SUPPORT). The card then
+ends the transfer by itself, without CMD12 or a Stop Tran token, and can
+prepare for the number of blocks. */
+bool sd_use_cmd23(sd_card_t *sd_card_p) {
+    return sd_card_p->state.cmd23_supported && !sd_card_p->no_cmd23;
+}
+
+/* Multiple block writes of known length can also be preceded by ACMD23
+SET_WR_BLK_ERASE_COUNT, so that the card can erase the blocks ahead of the
+write instead of preserving their old contents in a partly written erase
+block. It is only a hint. Returns the argument for ACMD23, or 0 if it
+shouldn't be sent. */
+uint32_t sd_pre_erase_count(sd_card_t *sd_card_p, uint32_t blocks) {
+    if (blocks < 2 || sd_card_p->no_pre_erase || !sd_card_p->state.pre_erase_supported)
+        return 0;
+    return blocks < 0x7FFFFF ? blocks : 0x7FFFFF;  // 23 bit field
+}
+
+bool sd_crc_sample(sd_card_t *sd_card_p) {
+    sd_crc_stats_t *stats_p = &sd_card_p->state.rx_crc;
+    if (SD_CRC_SAMPLED == sd_card_p->rx_crc_policy && sd_card_p->rx_crc_sample_interval > 1 &&
+        stats_p->sample_count++ % sd_card_p->rx_crc_sample_interval) {
+        ++stats_p->skipped;
+        return false;
+    }
+    ++stats_p->checked;
+    return true;
+}
+
+void sd_crc_error(sd_card_t *sd_card_p, bool late) {
+    sd_crc_stats_t *stats_p = &sd_card_p->state.rx_crc;
+    if (sd_card_p->rx_crc_policy < SD_CRC_POLICIES)
+        ++stats_p->errors[sd_card_p->rx_crc_policy];
+    if (late)
+        ++stats_p->late_errors;
+}
+
 sd_card_t *sd_get_by_drive_prefix(const char *const drive_prefix) {
     // Numeric drive number is always valid
     if (2 == strlen(drive_prefix) && isdigit((unsigned char)drive_prefix[0]) &&
@@ -183,6 +389,10 @@ bool sd_init_driver() {
                     myASSERT(sd_card_p->sdio_if_p);
                     sd_sdio_ctor(sd_card_p);
                     break;
+                case SD_IF_RAID:
+                    myASSERT(sd_card_p->raid_if_p);
+                    sd_raid_ctor(sd_card_p);
+                    break;
                 default:
                     myASSERT(false);
             }  // switch (sd_card_p->type)
@@ -320,7 +530,7 @@ void csdDmp(sd_card_t *sd_card_p, printer_t printer) {
 is a physical boundary of the card and consists of one or more blocks and its
 size depends on each card. */
 bool sd_allocation_unit(sd_card_t *sd_card_p, size_t *au_size_bytes_p) {
-    if (SD_IF_SPI == sd_card_p->type) return false;  // SPI can't do full SD Status
+    if (SD_IF_SDIO != sd_card_p->type) return false;  // SPI can't do full SD Status
 
     uint8_t status[64] = {0};
     bool ok = rp2040_sdio_get_sd_status(sd_card_p, status);
@@ -40,12 +40,21 @@ specific language governing permissions and limitations under the License.
 extern "C" {
 #endif
 
-typedef enum { SD_IF_NONE, SD_IF_SPI, SD_IF_SDIO } sd_if_t;
+typedef enum { SD_IF_NONE, SD_IF_SPI, SD_IF_SDIO, SD_IF_RAID } sd_if_t;
 
 typedef struct sd_spi_if_state_t {
     bool ongoing_mlt_blk_wrt;
     uint32_t cont_sector_wrt;
     uint32_t n_wrt_blks_reqd;
+    uint32_t wr_run_time;  // When the open multiple block write last got a block (millis)
+    bool blk_cnt_set;  // Write was declared with CMD23, so it ends by itself
+    uint32_t wr_blks_left;  // Blocks of the declared write still to come
+    bool card_busy;    // Card may still be programming the last block written
+    // Last block of a read under SD_CRC_DEFERRED, still to be checked.
+    // It is a copy, since the caller may reuse its buffer right away.
+    uint8_t *deferred_buf;  // deferred_block, or NULL
+    uint16_t deferred_crc;
+    uint8_t deferred_block[512];
 } sd_spi_if_state_t;
 
 typedef struct sd_spi_if_t {
@@ -74,6 +83,10 @@ typedef struct sd_sdio_if_t {
     uint DMA_IRQ_num;  // DMA_IRQ_0 or DMA_IRQ_1
     bool use_exclusive_DMA_IRQ_handler;
     uint baud_rate;
+    // Switch the card to High Speed mode if baud_rate is above 25 MHz.
+    // Opt-in: the PIO programs sample the bus right after the rising clock edge,
+    // which suits Default Speed timing. Check the data on the hardware first.
+    bool use_high_speed;
     // Drive strength levels for GPIO outputs:
     // GPIO_DRIVE_STRENGTH_2MA
     // GPIO_DRIVE_STRENGTH_4MA
@@ -92,12 +105,84 @@ typedef struct sd_sdio_if_t {
     sd_sdio_if_state_t state;
 } sd_sdio_if_t;
 
+// SDIO bus speed modes (for 3.3 V signaling)
+typedef enum {
+    SD_BUS_SPEED_DEFAULT,  // Up to 25 MHz
+    SD_BUS_SPEED_HIGH      // Up to 50 MHz; selected with CMD6 SWITCH_FUNC
+} sd_bus_speed_t;
+
+// Bus speed profile negotiated with the card
+typedef struct sd_bus_profile_t {
+    sd_bus_speed_t speed;
+    uint32_t max_clk_hz;  // Limit of the speed mode
+    uint32_t clk_hz;      // Requested bus clock
+} sd_bus_profile_t;
+
+/* Adaptive bus clock
+
+The bus clock starts at max_hz: the configured baud_rate (SPI) or the
+negotiated bus profile (SDIO). The interface drivers report data CRC
+errors. If CRC errors cluster, the clock is stepped down. After a clean
+streak, it is stepped back up, but not above max_hz. At initialization,
+a short training run steps the clock down until a number of reads in a
+row are clean. See sd_card.c for the parameters.
+*/
+typedef struct sd_clk_stats_t {
+    uint32_t max_hz;      // Ceiling; 0 while the clock is not managed (initialization)
+    uint32_t clk_hz;      // Clock chosen
+    uint32_t actual_hz;   // Clock the hardware actually runs at
+    uint32_t blocks;      // Data blocks checked
+    uint32_t crc_errors;  // Data blocks with CRC errors
+    uint32_t steps_down;
+    uint32_t steps_up;
+    // Adaptation state
+    uint32_t window_start;  // Value of blocks at the first error in the window
+    uint32_t window_errors;
+    uint32_t clean_streak;
+    bool training;
+} sd_clk_stats_t;
+
+/* Receive CRC policy
+
+Every data block received from the card carries a CRC. The policy of a card
+(sd_card_t::rx_crc_policy, which may be changed at any time) chooses how the
+blocks of a read are checked:
+SD_CRC_STRICT: every block is checked before the read completes (the default).
+SD_CRC_DEFERRED: the read completes as soon as the data is in. The last
+    blocks are copied, and their checks finish at the start of the next
+    operation on the card, so the caller is free to reuse its buffers.
+    A failed late check is logged and counted, but the data has already
+    been returned.
+SD_CRC_SAMPLED: one block in rx_crc_sample_interval is checked.
+Only data blocks are affected; registers are always checked.
+*/
+typedef enum {
+    SD_CRC_STRICT,
+    SD_CRC_DEFERRED,
+    SD_CRC_SAMPLED,
+    SD_CRC_POLICIES
+} sd_crc_policy_t;
+
+typedef struct sd_crc_stats_t {
+    uint32_t checked;                  // Blocks checked
+    uint32_t skipped;                  // Blocks not checked (SD_CRC_SAMPLED)
+    uint32_t errors[SD_CRC_POLICIES];  // CRC errors found under each policy
+    uint32_t late_errors;              // Found after the read had completed (SD_CRC_DEFERRED)
+    uint32_t sample_count;
+} sd_crc_stats_t;
+
 typedef struct sd_card_state_t {
     DSTATUS m_Status;       // Card status
     card_type_t card_type;  // Assigned dynamically
     CSD_t CSD;              // Card-Specific Data register.
     CID_t CID;              // Card IDentification register
+    SCR_t SCR;              // SD Configuration Register
+    bool cmd23_supported;   // From SCR; cleared if the card rejects CMD23
+    bool pre_erase_supported;  // Cleared if the card rejects ACMD23
     uint32_t sectors;       // Assigned dynamically
+    sd_bus_profile_t bus_profile;  // SDIO only
+    sd_clk_stats_t clk;            // Adaptive bus clock
+    sd_crc_stats_t rx_crc;         // Receive CRC checks
 
     mutex_t mutex;
     FATFS fatfs;
@@ -111,18 +196,162 @@ typedef struct sd_card_state_t {
 
 typedef struct sd_card_t sd_card_t;
 
+/* Scatter-gather block I/O
+
+One segment of a vectored transfer: count blocks to or from buffer.
+The segments of a request map to consecutive blocks on the card,
+so the whole request can be done with a single multiple block command.
+*/
+typedef struct sd_iovec_t {
+    uint8_t *buffer;
+    uint32_t count;  // Number of blocks
+} sd_iovec_t;
+
+/* Asynchronous (non-blocking) block I/O
+
+A request is started with sd_card_t::read_blocks_async or write_blocks_async,
+which return as soon as the command has been sent and the DMA is armed
+(or, for an SPI card, as soon as the request is queued for a shared SPI).
+Completion is reported by sd_async_poll() (returns false when the request is
+no longer busy) and, optionally, by the callback, which is invoked from
+within sd_async_poll() on the polling core.
+
+The card is locked from the start of the request until its completion,
+so no other operation (including FatFs calls) may be issued on the card
+until then. Buffers must remain valid until completion.
+*/
+typedef enum {
+    SD_ASYNC_IDLE,
+    SD_ASYNC_BUSY,
+    SD_ASYNC_DONE
+} sd_async_status_t;
+
+typedef struct sd_async_req_t sd_async_req_t;
+typedef void (*sd_async_cb_t)(sd_async_req_t *req_p);
+
+struct sd_async_req_t {
+    sd_async_cb_t callback;  // Optional; called on completion
+    void *context;           // For the caller's use
+
+    /* The following fields are state variables and not part of the configuration.
+    They are dynamically assigned. */
+    volatile sd_async_status_t status;
+    block_dev_err_t result;  // Valid when status is SD_ASYNC_DONE
+    sd_card_t *sd_card_p;
+    bool write;
+    union {
+        uint8_t *rd_buf;
+        const uint8_t *wr_buf;
+    };
+    uint32_t sector;
+    uint32_t count;
+    uint32_t blocks_done;
+    uint32_t start_time;
+    // Interface specific progress
+    int phase;
+    uint8_t *prev_buf;
+    uint16_t prev_crc;
+    bool sniffed;  // The DMA sniffer computes the CRC of the current block
+    uint32_t ticket;  // Place in the queue for a shared bus
+};
+
+/* Transfers on several cards at once
+
+Each transfer is an asynchronous request on its card. sd_multi_poll() starts
+the transfers and advances them all together, so that cards with their own
+state machines and DMA channels (e.g., SDIO cards on pio0 and pio1) move data
+at the same time. Transfers on the same card are done one after another, in
+array order. SPI cards that share an SPI take turns with it.
+The req of each transfer must be idle (e.g., zeroed) to begin with.
+*/
+typedef struct sd_multi_xfer_t {
+    sd_card_t *sd_card_p;
+    bool write;
+    uint8_t *buffer;
+    uint32_t sector;
+    uint32_t count;  // Number of blocks
+    sd_async_req_t req;
+} sd_multi_xfer_t;
+
+/* Striped (RAID 0) and mirrored (RAID 1) volumes
+
+An sd_card_t of type SD_IF_RAID presents its member cards as one drive.
+The members are configured as cards of their own (in the hw_config list,
+so they get initialized), but must not be mounted themselves.
+
+SD_RAID_0: Stripe k of the volume is on member k % num_members, at stripe
+k / num_members. The stripes of a request go to the members in parallel,
+with sd_multi_wait().
+
+SD_RAID_1: Every member holds a copy of the volume. Writes go to all members
+in parallel. A read goes to one member, the one that continues its last read
+or else the one that has read the least, and long reads are split between the
+members. A member that fails or is removed is dropped, and the regions written
+while it is out are marked in a dirty bitmap. When it comes back (see
+sd_raid_resilver_step), only those regions are copied to it, unless it is a
+different card, which is copied in full. The bitmap is kept in RAM, so after
+a restart the members are taken to be in sync (see sd_raid_rebuild).
+*/
+#define SD_RAID_MAX_MEMBERS 4
+// Default stripe size in blocks (32 KiB)
+#ifndef SD_RAID_STRIPE_BLOCKS
+#define SD_RAID_STRIPE_BLOCKS 64
+#endif
+// Number of regions in the dirty bitmap of a mirror
+#ifndef SD_RAID_DIRTY_BITS
+#define SD_RAID_DIRTY_BITS 4096
+#endif
+
+typedef enum { SD_RAID_0, SD_RAID_1 } sd_raid_level_t;
+
+typedef enum {
+    SD_RAID_MEMBER_ACTIVE,      // In sync
+    SD_RAID_MEMBER_FAILED,      // Out of the volume
+    SD_RAID_MEMBER_REBUILDING   // Gets writes, but not reads, until it is resilvered
+} sd_raid_member_status_t;
+
+typedef struct sd_raid_member_state_t {
+    sd_raid_member_status_t status;
+    CID_t CID;               // To recognize the card when it comes back
+    uint32_t next_sector;    // Sector after the last read
+    uint32_t blocks_read;
+    uint32_t blocks_written;
+    uint32_t errors;
+} sd_raid_member_state_t;
+
+typedef struct sd_raid_if_t {
+    sd_raid_level_t level;
+    sd_card_t **members;
+    size_t num_members;       // 2 to SD_RAID_MAX_MEMBERS
+    uint32_t stripe_blocks;   // Stripe size in blocks: a power of 2, or 0 for SD_RAID_STRIPE_BLOCKS
+
+    /* The following fields are not part of the configuration.
+    They are state variables, and are dynamically assigned. */
+    uint32_t member_sectors;  // Blocks used on each member
+    // SD_RAID_1:
+    sd_raid_member_state_t member_state[SD_RAID_MAX_MEMBERS];
+    uint32_t region_blocks;   // Blocks per bit of the dirty bitmap
+    uint32_t dirty[SD_RAID_DIRTY_BITS / 32];
+    uint32_t resilver_sector; // Position of the resilver pass
+} sd_raid_if_t;
+
 // "Class" representing SD Cards
 struct sd_card_t {
     sd_if_t type;  // Interface type
     union {
         sd_spi_if_t *spi_if_p;
         sd_sdio_if_t *sdio_if_p;
+        sd_raid_if_t *raid_if_p;
     };
     bool use_card_detect;
     uint card_detect_gpio;    // Card detect; ignored if !use_card_detect
     uint card_detected_true;  // Varies with card socket; ignored if !use_card_detect
     bool card_detect_use_pull;
     bool card_detect_pull_hi;
+    bool no_cmd23;  // Don't declare block counts with CMD23, even if the card supports it
+    bool no_pre_erase;  // Don't send ACMD23 SET_WR_BLK_ERASE_COUNT before multiple block writes
+    sd_crc_policy_t rx_crc_policy;    // How received data blocks are checked
+    uint32_t rx_crc_sample_interval;  // SD_CRC_SAMPLED: check one block in this many
 
     /* The following fields are state variables and not part of the configuration.
     They are dynamically assigned. */
@@ -134,6 +363,18 @@ struct sd_card_t {
                                     uint32_t ulSectorNumber, uint32_t blockCnt);
     block_dev_err_t (*read_blocks)(sd_card_t *sd_card_p, uint8_t *buffer,
                                    uint32_t ulSectorNumber, uint32_t ulSectorCount);
+    block_dev_err_t (*write_blocks_v)(sd_card_t *sd_card_p, const sd_iovec_t *iov,
+                                      uint32_t iovcnt, uint32_t ulSectorNumber);
+    block_dev_err_t (*read_blocks_v)(sd_card_t *sd_card_p, const sd_iovec_t *iov,
+                                     uint32_t iovcnt, uint32_t ulSectorNumber);
+    block_dev_err_t (*write_blocks_async)(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                          const uint8_t *buffer, uint32_t ulSectorNumber,
+                                          uint32_t blockCnt);
+    block_dev_err_t (*read_blocks_async)(sd_card_t *sd_card_p, sd_async_req_t *req_p,
+                                         uint8_t *buffer, uint32_t ulSectorNumber,
+                                         uint32_t ulSectorCount);
+    // Advance an asynchronous request. Returns true while the request is busy.
+    bool (*poll_async)(sd_card_t *sd_card_p, sd_async_req_t *req_p);
     block_dev_err_t (*sync)(sd_card_t *sd_card_p);
     uint32_t (*get_num_sectors)(sd_card_t *sd_card_p);
 
@@ -151,6 +392,35 @@ bool sd_card_detect(sd_card_t *sd_card_p);
 void cidDmp(sd_card_t *sd_card_p, printer_t printer);
 void csdDmp(sd_card_t *sd_card_p, printer_t printer);
 bool sd_allocation_unit(sd_card_t *sd_card_p, size_t *au_size_bytes_p);
+bool sd_use_cmd23(sd_card_t *sd_card_p);
+uint32_t sd_pre_erase_count(sd_card_t *sd_card_p, uint32_t blocks);
+// Returns false if the CRC of the next received data block is not to be checked
+bool sd_crc_sample(sd_card_t *sd_card_p);
+// Count a received data block with a bad CRC
+void sd_crc_error(sd_card_t *sd_card_p, bool late);
+
+void sd_async_start(sd_card_t *sd_card_p, sd_async_req_t *req_p, bool write, uint32_t sector,
+                    uint32_t count);
+void sd_async_complete(sd_async_req_t *req_p, block_dev_err_t result);
+bool sd_async_poll(sd_async_req_t *req_p);
+block_dev_err_t sd_async_wait(sd_async_req_t *req_p);
+// Returns true while any of the transfers is not done
+bool sd_multi_poll(sd_multi_xfer_t xfers[], size_t n);
+// Returns the result of the first transfer that failed, if any
+block_dev_err_t sd_multi_wait(sd_multi_xfer_t xfers[], size_t n);
+uint32_t sd_iov_blocks(const sd_iovec_t *iov, uint32_t iovcnt);
+
+void sd_clk_init(sd_card_t *sd_card_p, uint32_t max_hz);
+// Report the outcome of a data transfer. Returns true if clk_hz has changed,
+// in which case the interface driver must apply it.
+bool sd_clk_feedback(sd_card_t *sd_card_p, uint32_t blocks, uint32_t crc_errors);
+// probe does a small read, reporting CRC errors with sd_clk_feedback,
+// and returns false if it fails.
+void sd_clk_train(sd_card_t *sd_card_p, bool (*probe)(sd_card_t *sd_card_p));
+
+// Scatter-gather counterparts of the FatFs disk_read and disk_write (see glue.c)
+DRESULT disk_read_v(BYTE pdrv, const sd_iovec_t *iov, UINT iovcnt, LBA_t sector);
+DRESULT disk_write_v(BYTE pdrv, const sd_iovec_t *iov, UINT iovcnt, LBA_t sector);
 sd_card_t *sd_get_by_drive_prefix(const char *const name);
 
 // sd_init_driver() must be called before this:
@@ -66,6 +66,7 @@ typedef enum {                          /* Number on wire in parens */
     CMD17_READ_SINGLE_BLOCK = 17,       /* (0x51) Read single block of data */
     CMD18_READ_MULTIPLE_BLOCK = 18,     /* (0x52) Continuously Card transfers data blocks to host
          until interrupted by a STOP_TRANSMISSION command */
+    CMD23_SET_BLOCK_COUNT = 23,         /* Number of blocks for the next CMD18 or CMD25 */
     CMD24_WRITE_BLOCK = 24,             /* (0x58) Write single block of data */
     CMD25_WRITE_MULTIPLE_BLOCK = 25,    /* (0x59) Continuously writes blocks of data
         until    'Stop Tran' token is sent */
@@ -25,6 +25,10 @@ extern "C" {
 // Table 5-2: The CID Fields
 typedef uint8_t CID_t[16];
 
+// SD Configuration Register (Table 5-17). 64 bits wide.
+// CMD_SUPPORT is at [35:32]; bit 33 is CMD23 (SET_BLOCK_COUNT) support.
+typedef uint8_t SCR_t[8];
+
 /*
 +---------------+-----------------------+-------------------------------------+
 | CSD_STRUCTURE | CSD structure version | Card Capacity                       |
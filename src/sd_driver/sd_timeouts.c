@@ -16,4 +16,5 @@ sd_timeouts_t sd_timeouts __attribute__((weak)) = {
     .rp2040_sdio_tx_poll = 5000, // Timeout in ms for response
     .sd_sdio_begin = 1000, // Timeout in ms for response
     .sd_sdio_stopTransmission = 200, // Timeout in ms for response
+    .sd_sdio_busy = SD_SDIO_BUSY_DEFAULT_MS, // Timeout in ms for the card to finish programming
 };
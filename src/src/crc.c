@@ -376,4 +376,9 @@ uint16_t crc16(uint8_t const *data, int const length)
 	return crc16ibm_3740_word(crc, data, length);
 }
 
+uint16_t crc16_update(uint16_t crc, uint8_t const *data, int const length)
+{
+	return crc16ibm_3740_word(crc, data, length);
+}
+
 /* [] END OF FILE */
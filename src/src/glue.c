@@ -123,6 +123,42 @@ DRESULT disk_write(BYTE pdrv, /* Physical drive number to identify the drive */
 
 #endif
 
+/*-----------------------------------------------------------------------*/
+/* Read Sector(s) into a list of buffers                                 */
+/*-----------------------------------------------------------------------*/
+
+DRESULT disk_read_v(BYTE pdrv, /* Physical drive number to identify the drive */
+                    const sd_iovec_t *iov, /* Data buffers and their sector counts */
+                    UINT iovcnt,  /* Number of buffers */
+                    LBA_t sector  /* Start sector in LBA */
+) {
+    TRACE_PRINTF(">>> %s\n", __FUNCTION__);
+    sd_card_t *sd_card_p = sd_get_by_num(pdrv);
+    if (!sd_card_p) return RES_PARERR;
+    int rc = sd_card_p->read_blocks_v(sd_card_p, iov, iovcnt, sector);
+    return sdrc2dresult(rc);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Write Sector(s) from a list of buffers                                */
+/*-----------------------------------------------------------------------*/
+
+#if FF_FS_READONLY == 0
+
+DRESULT disk_write_v(BYTE pdrv, /* Physical drive number to identify the drive */
+                     const sd_iovec_t *iov, /* Data buffers and their sector counts */
+                     UINT iovcnt,  /* Number of buffers */
+                     LBA_t sector  /* Start sector in LBA */
+) {
+    TRACE_PRINTF(">>> %s\n", __FUNCTION__);
+    sd_card_t *sd_card_p = sd_get_by_num(pdrv);
+    if (!sd_card_p) return RES_PARERR;
+    int rc = sd_card_p->write_blocks_v(sd_card_p, iov, iovcnt, sector);
+    return sdrc2dresult(rc);
+}
+
+#endif
+
 /*-----------------------------------------------------------------------*/
 /* Miscellaneous Functions                                               */
 /*-----------------------------------------------------------------------*/
@@ -157,7 +193,9 @@ DRESULT disk_ioctl(BYTE pdrv, /* Physical drive number (0..) */
                                 // f_mkfs function and it attempts to align data
                                 // area on the erase block boundary. It is
                                 // required when FF_USE_MKFS == 1.
-            static DWORD bs = 1;
+            DWORD bs = 1;
+            // Align the data area of a striped volume on stripes
+            if (SD_IF_RAID == sd_card_p->type) bs = sd_card_p->raid_if_p->stripe_blocks;
             *(DWORD *)buff = bs;
             return RES_OK;
         }